@@ -0,0 +1,301 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "render.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// most bytes one cell can take to send: a cursor move, a colour change
+// and the character itself
+#define ANSI_CELL_MAX 32
+
+// what clears the terminal and puts the cursor top left
+#define ANSI_CLEAR "\033[0m\033[H\033[2J"
+
+
+
+// ------------------------------------------------------------
+// Output buffer.
+// ------------------------------------------------------------
+
+// what switches the terminal to each colour
+static char *sgr[NUM_COLOURS] = {
+  "\033[0m",      // plain
+  "\033[37;47m",  // snake: white on white
+  "\033[36;46m",  // wall: cyan on cyan
+  "\033[31;41m",  // food: red on red
+  "\033[30;47m",  // highlight: black on white
+  "\033[0;32m",   // slider: green
+};
+
+static const struct cell blank_cell = { ' ', COLOUR_PLAIN };
+
+/*  Add bytes to the frame being sent. There is always room, since out is
+    sized for every cell changing in the most expensive way. */
+static void
+emit (struct ansi_screen *screen, char *bytes, int len)
+{
+  memcpy(screen->out + screen->out_len, bytes, len);
+  screen->out_len += len;
+}
+
+/*  Write all of a buffer, with as few calls as the kernel allows; for a
+    terminal that is one. Returns zero if it couldn't be written. */
+static int
+write_all (int fd, char *buf, size_t len)
+{
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = write(fd, buf + done, len - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+    done += n;
+  }
+  return 1;
+}
+
+
+
+// ------------------------------------------------------------
+// Frame sending.
+// ------------------------------------------------------------
+
+/*  Send a cell of the new frame where the cursor is, and move the cursor
+    on. A cursor which has reached the last column might have wrapped or
+    not, depending on the terminal, so after that it's somewhere unknown. */
+static void
+send_cell (struct ansi_screen *screen, int c)
+{
+  emit(screen, &screen->back[c].c, 1);
+  screen->front[c] = screen->back[c];
+  screen->cursor_col++;
+  if (screen->cursor_col >= screen->cols) screen->cursor_row = -1;
+}
+
+/*  Check whether every cell of a row from one column up to another is to
+    be drawn in a colour, so sending them again costs no colour change. */
+static int
+all_colour (struct ansi_screen *screen, int row, int from, int to, Colour colour)
+{
+  struct cell *cells = &screen->back[row * screen->cols];
+  int col;
+  for (col=from; col<to; col++) {
+    if (cells[col].colour != colour) return 0;
+  }
+  return 1;
+}
+
+/*  Move the cursor to a cell, in as few bytes as possible. Moving right
+    along a row can be done by moving forward, or by sending the cells in
+    between again if they're in the current colour and that's shorter. */
+static void
+move_to (struct ansi_screen *screen, int row, int col)
+{
+  if (screen->cursor_row == row && screen->cursor_col == col) return;
+
+  char jump[32];
+  int jump_len = snprintf(jump, sizeof jump, "\033[%d;%dH", row + 1, col + 1);
+
+  if (screen->cursor_row == row && col > screen->cursor_col) {
+    int gap = col - screen->cursor_col;
+    char forward[32];
+    int forward_len = snprintf(forward, sizeof forward, "\033[%dC", gap);
+    if (gap <= forward_len && gap <= jump_len &&
+        all_colour(screen, row, screen->cursor_col, col, screen->colour)) {
+      while (screen->cursor_col < col) {
+        send_cell(screen, row * screen->cols + screen->cursor_col);
+      }
+      return;
+    }
+    if (forward_len < jump_len) {
+      emit(screen, forward, forward_len);
+      screen->cursor_col = col;
+      return;
+    }
+  }
+
+  emit(screen, jump, jump_len);
+  screen->cursor_row = row;
+  screen->cursor_col = col;
+}
+
+/*  Send everything which differs between the new frame and what the
+    terminal is showing. The changed cells are found first, then sent a
+    colour at a time, starting with the colour the terminal is already
+    in, so that each colour change is sent at most once a frame. */
+static int
+ansi_present (struct backend *backend)
+{
+  struct ansi_screen *screen = backend->data;
+  int cols = screen->cols;
+  screen->out_len = 0;
+
+  if (screen->invalid) {
+    emit(screen, ANSI_CLEAR, strlen(ANSI_CLEAR));
+    int c;
+    for (c=0; c<screen->rows * cols; c++) screen->front[c] = blank_cell;
+    screen->cursor_row = 0;
+    screen->cursor_col = 0;
+    screen->colour = COLOUR_PLAIN;
+    screen->invalid = 0;
+  }
+
+  // Find the cells which have changed, skipping whole rows which haven't.
+  int num_changed = 0;
+  int row, col;
+  for (row=0; row<screen->rows; row++) {
+    struct cell *front = &screen->front[row * cols];
+    struct cell *back = &screen->back[row * cols];
+    if (memcmp(front, back, cols * sizeof (struct cell)) == 0) continue;
+    for (col=0; col<cols; col++) {
+      if (front[col].c != back[col].c || front[col].colour != back[col].colour) {
+        screen->changed[num_changed++] = row * cols + col;
+      }
+    }
+  }
+
+  // Send them, a colour at a time, starting with the colour the terminal
+  // was left in. The order is worked out from that colour as it was when
+  // the frame started, since sending cells changes it.
+  Colour first = screen->colour;
+  int i, k;
+  for (k=0; k<NUM_COLOURS; k++) {
+    Colour colour = k == 0 ? first : (k == first ? 0 : k);
+    for (i=0; i<num_changed; i++) {
+      int c = screen->changed[i];
+      struct cell cell = screen->back[c];
+      if (cell.colour != colour) continue;
+      if (cell.c == screen->front[c].c && cell.colour == screen->front[c].colour) continue;
+      if (screen->colour != colour) {
+        emit(screen, sgr[colour], strlen(sgr[colour]));
+        screen->colour = colour;
+      }
+      move_to(screen, c / cols, c % cols);
+      send_cell(screen, c);
+    }
+  }
+
+  if (screen->out_len == 0) return 1;
+  if (!write_all(screen->fd, screen->out, screen->out_len)) {
+    screen->invalid = 1;
+    return 0;
+  }
+  backend->bytes += screen->out_len;
+  return 1;
+}
+
+
+
+// ------------------------------------------------------------
+// Frame building.
+// ------------------------------------------------------------
+
+static void
+ansi_put (struct backend *backend, int row, int col, char c, Colour colour)
+{
+  struct ansi_screen *screen = backend->data;
+  if (row < 0 || row >= screen->rows || col < 0 || col >= screen->cols) return;
+  struct cell *cell = &screen->back[row * screen->cols + col];
+  cell->c = c;
+  cell->colour = colour;
+}
+
+/*  Write text in the plain colour, and blank the rest of the row. */
+static void
+ansi_print (struct backend *backend, int row, int col, char *text)
+{
+  struct ansi_screen *screen = backend->data;
+  if (row < 0 || row >= screen->rows) return;
+  struct cell *cells = &screen->back[row * screen->cols];
+  for (; col < screen->cols && *text != '\0'; col++, text++) {
+    cells[col].c = *text;
+    cells[col].colour = COLOUR_PLAIN;
+  }
+  for (; col < screen->cols; col++) cells[col] = blank_cell;
+}
+
+static void
+ansi_blank (struct backend *backend)
+{
+  struct ansi_screen *screen = backend->data;
+  int c;
+  for (c=0; c<screen->rows * screen->cols; c++) screen->back[c] = blank_cell;
+}
+
+static void
+free_frames (struct ansi_screen *screen)
+{
+  free(screen->front);
+  free(screen->back);
+  free(screen->changed);
+  free(screen->out);
+  screen->front = screen->back = NULL;
+  screen->changed = NULL;
+  screen->out = NULL;
+}
+
+/*  Free the frames. The terminal is put back in its own colours, so that
+    whatever draws on it next doesn't clear it to the colour of the food. */
+static void
+ansi_close (struct backend *backend)
+{
+  struct ansi_screen *screen = backend->data;
+  if (screen->colour != COLOUR_PLAIN) {
+    write_all(screen->fd, sgr[COLOUR_PLAIN], strlen(sgr[COLOUR_PLAIN]));
+    screen->colour = COLOUR_PLAIN;
+  }
+  free_frames(screen);
+}
+
+/*  Size the frames for the terminal. What the terminal shows isn't known
+    afterwards, so the next frame repaints it all. */
+static void
+ansi_resize (struct backend *backend, int rows, int cols)
+{
+  struct ansi_screen *screen = backend->data;
+  free_frames(screen);
+  screen->rows = rows;
+  screen->cols = cols;
+  size_t cells = (size_t) rows * cols;
+  screen->front = malloc(cells * sizeof (struct cell));
+  screen->back = malloc(cells * sizeof (struct cell));
+  screen->changed = malloc(cells * sizeof (int));
+  screen->out_size = cells * ANSI_CELL_MAX + strlen(ANSI_CLEAR);
+  screen->out = malloc(screen->out_size);
+  screen->invalid = 1;
+  ansi_blank(backend);
+}
+
+/*  Set up a backend which writes ANSI escape sequences for a terminal of
+    the given size to fd, one write a frame. screen is used to store the
+    backend's state, and the frames it allocates are freed by close. */
+void
+init_ansi_backend (struct backend *backend, struct ansi_screen *screen,
+                   int fd, int rows, int cols)
+{
+  backend->name = "ansi";
+  backend->put = ansi_put;
+  backend->print = ansi_print;
+  backend->blank = ansi_blank;
+  backend->resize = ansi_resize;
+  backend->present = ansi_present;
+  backend->close = ansi_close;
+  backend->data = screen;
+  backend->bytes = 0;
+
+  screen->fd = fd;
+  screen->colour = COLOUR_PLAIN;
+  screen->front = screen->back = NULL;
+  screen->changed = NULL;
+  screen->out = NULL;
+  ansi_resize(backend, rows, cols);
+}
@@ -0,0 +1,97 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// every allocation is aligned to this many bytes
+#define ARENA_ALIGN 16
+
+
+
+// ------------------------------------------------------------
+// Arena functions.
+// ------------------------------------------------------------
+
+/*  Set up an empty arena. Memory is taken from malloc block_size bytes at
+    a time, or more if a single allocation needs it. */
+void
+init_arena (struct arena *arena, size_t block_size)
+{
+  arena->first = NULL;
+  arena->current = NULL;
+  arena->block_size = block_size;
+}
+
+/*  Allocate size bytes from the arena. The memory lives until the arena
+    is reset or freed. */
+void *
+arena_alloc (struct arena *arena, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+  // Use the first block from the current one on which has room, so blocks
+  // kept by a reset get filled again in order.
+  struct arena_block *block = arena->current;
+  while (block != NULL && block->size - block->used < size) block = block->next;
+
+  // Nothing has room: add a new block to the end of the list.
+  if (block == NULL) {
+    size_t block_size = size > arena->block_size ? size : arena->block_size;
+    block = malloc(sizeof (struct arena_block) + block_size);
+    block->next = NULL;
+    block->size = block_size;
+    block->used = 0;
+    if (arena->first == NULL) arena->first = block;
+    else {
+      struct arena_block *last = arena->current ? arena->current : arena->first;
+      while (last->next != NULL) last = last->next;
+      last->next = block;
+    }
+  }
+
+  arena->current = block;
+  void *p = block->data + block->used;
+  block->used += size;
+  return p;
+}
+
+/*  Allocate size bytes from the arena, set to zero. */
+void *
+arena_calloc (struct arena *arena, size_t size)
+{
+  void *p = arena_alloc(arena, size);
+  memset(p, 0, size);
+  return p;
+}
+
+/*  Throw away everything allocated from the arena, but keep its blocks to
+    allocate from again. */
+void
+reset_arena (struct arena *arena)
+{
+  struct arena_block *block;
+  for (block = arena->first; block != NULL; block = block->next) block->used = 0;
+  arena->current = arena->first;
+}
+
+/*  Give all of the arena's memory back. */
+void
+free_arena (struct arena *arena)
+{
+  struct arena_block *block = arena->first;
+  while (block != NULL) {
+    struct arena_block *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->first = NULL;
+  arena->current = NULL;
+}
@@ -0,0 +1,46 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// a good block size for an arena holding one game on a normal board
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// A block of memory which an arena hands out from the front.
+struct arena_block {
+  struct arena_block *next;
+  size_t size;
+  size_t used;
+  _Alignas(16) char data[];
+};
+
+// An arena owns all the memory for something with a clear lifetime, such
+// as one game. Allocating is a pointer bump, nothing is freed on its own,
+// and everything goes at once with reset_arena or free_arena. A reset
+// keeps the blocks for reuse, so an arena which is reset between games
+// stops calling malloc once it has grown to fit the biggest one.
+struct arena {
+  struct arena_block *first;
+  struct arena_block *current;
+  size_t block_size;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+void init_arena (struct arena *arena, size_t block_size);
+void *arena_alloc (struct arena *arena, size_t size);
+void *arena_calloc (struct arena *arena, size_t size);
+void reset_arena (struct arena *arena);
+void free_arena (struct arena *arena);
+
+#endif
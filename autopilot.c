@@ -0,0 +1,567 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+#include "autopilot.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// what a flood fill returns when it runs out of time
+#define OUT_OF_TIME -1
+
+// words of frontiers grown between looks at the clock, which costs more
+// than growing a small board's frontier does
+#define WORDS_PER_CLOCK 1024
+
+
+
+// ------------------------------------------------------------
+// Bit board functions.
+// ------------------------------------------------------------
+
+/*  Get the time on the monotonic clock in nanoseconds. */
+static inline int64_t
+now_ns (void)
+{
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return (int64_t) tp.tv_sec * 1000000000L + tp.tv_nsec;
+}
+
+/*  Check whether the deadline has passed, having grown frontiers of rows
+    [lo, hi] since last asked. The clock is only read once enough words
+    have been grown since it was last read. */
+static inline int
+past_deadline (struct autopilot *pilot, int64_t deadline, int lo, int hi)
+{
+  pilot->words_grown += (long int) (hi - lo + 3) * pilot->words_per_row;
+  if (pilot->words_grown < WORDS_PER_CLOCK) return 0;
+  pilot->words_grown = 0;
+  return now_ns() > deadline;
+}
+
+/*  Get the cell next to p in direction dir. */
+static inline struct point
+neighbour (struct point p, Direction dir)
+{
+  switch (dir) {
+    case NORTH: p.row--; break;
+    case SOUTH: p.row++; break;
+    case WEST: p.col--; break;
+    case EAST: p.col++; break;
+  }
+  return p;
+}
+
+/*  Check whether a cell is in a bit board. */
+static inline int
+has_cell (struct autopilot *pilot, const uint64_t *board, struct point p)
+{
+  return board[(size_t) p.row * pilot->words_per_row + (p.col >> 6)] >> (p.col & 63) & 1;
+}
+
+/*  Check whether a cell is inside the walls and the snake isn't on it. */
+static inline int
+is_free (struct autopilot *pilot, struct snake *snake, struct point p)
+{
+  return has_cell(pilot, pilot->open, p) && !has_cell(pilot, snake->bits, p);
+}
+
+/*  Make a bit board hold only one cell, in the only row of it which is
+    read: rows outside a board's bounds are never looked at. */
+static void
+only_cell (struct autopilot *pilot, uint64_t *board, struct point p)
+{
+  uint64_t *row = board + (size_t) p.row * pilot->words_per_row;
+  memset(row, 0, pilot->words_per_row * sizeof (uint64_t));
+  row[p.col >> 6] = (uint64_t) 1 << (p.col & 63);
+}
+
+/*  Clear rows [lo, hi] of a bit board. */
+static void
+clear_rows (struct autopilot *pilot, uint64_t *board, int lo, int hi)
+{
+  if (lo > hi) return;
+  memset(board + (size_t) lo * pilot->words_per_row, 0,
+         (size_t) (hi - lo + 1) * pilot->words_per_row * sizeof (uint64_t));
+}
+
+/*  Get row r of a frontier which has cells only in rows [lo, hi], reading
+    any other row as empty. */
+static inline const uint64_t *
+frontier_row (struct autopilot *pilot, const uint64_t *front, int r, int lo, int hi)
+{
+  return r >= lo && r <= hi ? front + (size_t) r * pilot->words_per_row : pilot->zero;
+}
+
+/*  Grow words [from, end) of a row of a frontier, wpr words long. Each
+    word of the new frontier is the words above and below it, and the word
+    itself shifted a cell either way with the end bits of its neighbours
+    carried in, masked to the free cells not visited yet: 64 cells at a
+    time, with no branches on what's in them. The new cells go into to and
+    seen, and how many there are is added to *added. Returns the new cells
+    of the words OR'd together. */
+static inline uint64_t
+grow_words (const uint64_t *above, const uint64_t *row, const uint64_t *below,
+            const uint64_t *open, const uint64_t *taken, uint64_t *seen, uint64_t *to,
+            int from, int end, int wpr, long int *added)
+{
+  uint64_t grew = 0;
+  int w;
+  for (w=from; w<end; w++) {
+    uint64_t west = w > 0 ? row[w-1] : 0;
+    uint64_t east = w+1 < wpr ? row[w+1] : 0;
+    uint64_t g = (above[w] | below[w] | row[w] << 1 | west >> 63 | row[w] >> 1 | east << 63) &
+                 open[w] & ~taken[w] & ~seen[w];
+    to[w] = g;
+    seen[w] |= g;
+    grew |= g;
+    *added += __builtin_popcountll(g);
+  }
+  return grew;
+}
+
+/*  Grows a whole row of a frontier, as grow_words does. */
+typedef uint64_t (*grow_fn) (const uint64_t *above, const uint64_t *row, const uint64_t *below,
+                             const uint64_t *open, const uint64_t *taken, uint64_t *seen,
+                             uint64_t *to, int wpr, long int *added);
+
+/*  Grow a row a word at a time, however the compiler manages without
+    assuming anything about the CPU. */
+static uint64_t
+grow_row_plain (const uint64_t *above, const uint64_t *row, const uint64_t *below,
+                const uint64_t *open, const uint64_t *taken, uint64_t *seen,
+                uint64_t *to, int wpr, long int *added)
+{
+  return grow_words(above, row, below, open, taken, seen, to, 0, wpr, wpr, added);
+}
+
+#ifdef HAVE_X86
+
+// how many bits are set in each nibble, and a mask of the low nibble of
+// each byte, twice over to fill a register; they're loaded rather than
+// built so that a row costs little to start even without optimisation
+static const unsigned char nibble_bits[32] = {
+  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+static const unsigned char nibble_mask[32] = {
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15
+};
+
+/*  Grow a row four words at a time. The words either side of each four
+    are loaded one word along, so every lane has its west and east
+    neighbours lined up with it, and the new cells are counted with the
+    nibble table and sad of the minimap's kernel, a sum in each lane. The
+    first word, and the last few which would have the east load run off
+    the row, are grown one at a time. */
+__attribute__((target("avx2,popcnt")))
+static uint64_t
+grow_row_avx2 (const uint64_t *above, const uint64_t *row, const uint64_t *below,
+               const uint64_t *open, const uint64_t *taken, uint64_t *seen,
+               uint64_t *to, int wpr, long int *added)
+{
+  const __m256i table = _mm256_loadu_si256((const __m256i *) nibble_bits);
+  const __m256i nibble = _mm256_loadu_si256((const __m256i *) nibble_mask);
+  const __m256i zero = _mm256_setzero_si256();
+  uint64_t grew = grow_words(above, row, below, open, taken, seen, to, 0, 1, wpr, added);
+  __m256i any = zero, counts = zero;
+  int w;
+  for (w=1; w+5<=wpr; w+=4) {
+    __m256i mid = _mm256_loadu_si256((const __m256i *) (row + w));
+    __m256i west = _mm256_loadu_si256((const __m256i *) (row + w - 1));
+    __m256i east = _mm256_loadu_si256((const __m256i *) (row + w + 1));
+    __m256i near = _mm256_or_si256(_mm256_loadu_si256((const __m256i *) (above + w)),
+                                   _mm256_loadu_si256((const __m256i *) (below + w)));
+    near = _mm256_or_si256(near, _mm256_or_si256(_mm256_slli_epi64(mid, 1), _mm256_srli_epi64(west, 63)));
+    near = _mm256_or_si256(near, _mm256_or_si256(_mm256_srli_epi64(mid, 1), _mm256_slli_epi64(east, 63)));
+    __m256i was = _mm256_loadu_si256((const __m256i *) (seen + w));
+    __m256i blocked = _mm256_or_si256(_mm256_loadu_si256((const __m256i *) (taken + w)), was);
+    __m256i g = _mm256_andnot_si256(blocked, _mm256_and_si256(near, _mm256_loadu_si256((const __m256i *) (open + w))));
+    _mm256_storeu_si256((__m256i *) (to + w), g);
+    _mm256_storeu_si256((__m256i *) (seen + w), _mm256_or_si256(was, g));
+    any = _mm256_or_si256(any, g);
+    __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(g, nibble));
+    __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(g, 4), nibble));
+    counts = _mm256_add_epi64(counts, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero));
+  }
+  uint64_t lanes[4], bits[4];
+  _mm256_storeu_si256((__m256i *) lanes, counts);
+  _mm256_storeu_si256((__m256i *) bits, any);
+  *added += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  grew |= bits[0] | bits[1] | bits[2] | bits[3];
+  return grew | grow_words(above, row, below, open, taken, seen, to, w, wpr, wpr, added);
+}
+
+#endif
+
+/*  Grow a frontier by one step, into the free cells not visited yet, a
+    row at a time with grow. The frontier has cells only in rows [*lo,
+    *hi], so only the rows around those are worked on. The new cells go
+    into next and visited, *lo and *hi become the rows next has cells in,
+    and the number of new cells is returned. */
+static inline __attribute__((always_inline)) long int
+spread_rows (struct autopilot *pilot, const uint64_t *bits, const uint64_t *front,
+             uint64_t *next, int *lo, int *hi, grow_fn grow)
+{
+  int wpr = pilot->words_per_row;
+  int first = *lo - 1 < 1 ? 1 : *lo - 1;
+  int last = *hi + 1 > pilot->rows - 2 ? pilot->rows - 2 : *hi + 1;
+  long int added = 0;
+  int newLo = pilot->rows, newHi = -1;
+  int r;
+  for (r=first; r<=last; r++) {
+    const uint64_t *above = frontier_row(pilot, front, r-1, *lo, *hi);
+    const uint64_t *row = frontier_row(pilot, front, r, *lo, *hi);
+    const uint64_t *below = frontier_row(pilot, front, r+1, *lo, *hi);
+    size_t at = (size_t) r * wpr;
+    if (grow(above, row, below, pilot->open + at, bits + at, pilot->visited + at,
+             next + at, wpr, &added)) {
+      if (r < newLo) newLo = r;
+      newHi = r;
+    }
+  }
+  *lo = newLo;
+  *hi = newHi;
+  return added;
+}
+
+/*  Grow a frontier with the best version of a row the CPU can run. */
+static inline long int
+spread (struct autopilot *pilot, const uint64_t *bits, const uint64_t *front,
+        uint64_t *next, int *lo, int *hi)
+{
+#ifdef HAVE_X86
+  if (pilot->avx2) return spread_rows(pilot, bits, front, next, lo, hi, grow_row_avx2);
+#endif
+  return spread_rows(pilot, bits, front, next, lo, hi, grow_row_plain);
+}
+
+
+
+// ------------------------------------------------------------
+// Search functions.
+// ------------------------------------------------------------
+
+/*  Flood the free cells from start, which the head is about to move onto,
+    to see how much room it leads to. Stops once need cells have been
+    reached, and counts reaching the tail, which moves out of the way as
+    the snake does, as reaching need. Returns how many cells were reached,
+    at most need, or OUT_OF_TIME if the deadline passes first. */
+static long int
+flood (struct autopilot *pilot, struct snake *snake, struct point start,
+       long int need, int64_t deadline)
+{
+  struct point tail = snake_segment(snake, snake->length - 1);
+  uint64_t *front = pilot->front, *next = pilot->next;
+  only_cell(pilot, front, start);
+  pilot->visited[(size_t) start.row * pilot->words_per_row + (start.col >> 6)] |=
+    (uint64_t) 1 << (start.col & 63);
+  int lo = start.row, hi = start.row;
+  int seenLo = lo, seenHi = hi;
+  long int reached = 1;
+  int touched = 0;
+
+  while (1) {
+    Direction d;
+    for (d=NORTH; d<=WEST && !touched; d++) {
+      touched = has_cell(pilot, pilot->visited, neighbour(tail, d));
+    }
+    if (touched || reached >= need) break;
+    if (past_deadline(pilot, deadline, lo, hi)) {
+      reached = OUT_OF_TIME;
+      break;
+    }
+    long int added = spread(pilot, snake->bits, front, next, &lo, &hi);
+    if (added == 0) break;
+    reached += added;
+    if (lo < seenLo) seenLo = lo;
+    if (hi > seenHi) seenHi = hi;
+    uint64_t *t = front;
+    front = next;
+    next = t;
+  }
+  clear_rows(pilot, pilot->visited, seenLo, seenHi);
+  if (touched || reached > need) reached = need;
+  return reached;
+}
+
+/*  Search outward from the food, a layer at a time, for the nearest cell
+    next to the head, and make the shortest path there the plan. Returns 1
+    if a path was found, 0 if there is none the layers have room for, or
+    OUT_OF_TIME if the deadline passes first. */
+static int
+search (struct autopilot *pilot, struct game_state *state, int64_t deadline)
+{
+  struct snake *snake = state->snake;
+  struct point head = snake_head(snake);
+  struct point food = state->food;
+  size_t words = pilot->board_words;
+  pilot->searches++;
+  pilot->plan_len = pilot->plan_at = 0;
+
+  uint64_t *layer = pilot->layers;
+  only_cell(pilot, layer, food);
+  pilot->visited[(size_t) food.row * pilot->words_per_row + (food.col >> 6)] |=
+    (uint64_t) 1 << (food.col & 63);
+  pilot->layer_lo[0] = pilot->layer_hi[0] = food.row;
+  int seenLo = food.row, seenHi = food.row;
+
+  // Grow the layers until one of them reaches a cell next to the head.
+  // Every cell in a layer is free, so that's the way to go.
+  int k = 0, found;
+  Direction d;
+  while (1) {
+    for (d=NORTH; d<=WEST; d++) {
+      struct point p = neighbour(head, d);
+      if (p.row >= pilot->layer_lo[k] && p.row <= pilot->layer_hi[k] &&
+          has_cell(pilot, layer, p)) break;
+    }
+    if (d <= WEST) {
+      found = 1;
+      break;
+    }
+    if (k + 1 >= pilot->max_layers) {
+      found = 0;
+      break;
+    }
+    if (past_deadline(pilot, deadline, pilot->layer_lo[k], pilot->layer_hi[k])) {
+      found = OUT_OF_TIME;
+      break;
+    }
+    int lo = pilot->layer_lo[k], hi = pilot->layer_hi[k];
+    if (spread(pilot, snake->bits, layer, layer + words, &lo, &hi) == 0) {
+      found = 0;
+      break;
+    }
+    layer += words;
+    k++;
+    pilot->layer_lo[k] = lo;
+    pilot->layer_hi[k] = hi;
+    if (lo < seenLo) seenLo = lo;
+    if (hi > seenHi) seenHi = hi;
+  }
+  clear_rows(pilot, pilot->visited, seenLo, seenHi);
+  if (found != 1) return found;
+
+  // Walk back down the layers to the food.
+  pilot->plan[0] = d;
+  struct point at = neighbour(head, d);
+  int j;
+  for (j=k-1; j>=0; j--) {
+
+    // One of the cells next to each cell of a layer is in the layer below,
+    // so if it's none of the others it's the one to the west.
+    const uint64_t *down = pilot->layers + (size_t) j * words;
+    for (d=NORTH; d<WEST; d++) {
+      struct point p = neighbour(at, d);
+      if (p.row >= pilot->layer_lo[j] && p.row <= pilot->layer_hi[j] &&
+          has_cell(pilot, down, p)) break;
+    }
+    pilot->plan[k-j] = d;
+    at = neighbour(at, d);
+  }
+  pilot->plan_len = k + 1;
+  pilot->plan_food = food;
+  return 1;
+}
+
+/*  Check whether the plan has a move left for the food still on the
+    board, onto a cell which is free. */
+static int
+plan_open (struct autopilot *pilot, struct game_state *state)
+{
+  if (pilot->plan_at >= pilot->plan_len) return 0;
+  if (pilot->plan_food.row != state->food.row || pilot->plan_food.col != state->food.col) return 0;
+  struct point p = neighbour(snake_head(state->snake), pilot->plan[pilot->plan_at]);
+  return is_free(pilot, state->snake, p);
+}
+
+/*  Get the three moves the snake can make in the order they should be
+    tried: nearest the food first, and going straight on before turning
+    between moves as near as each other. */
+static void
+moves_toward_food (struct game_state *state, Direction *order)
+{
+  struct point head = snake_head(state->snake);
+  int distance[3];
+  int i, j, n = 0;
+  for (i=0; i<4; i++) {
+    Direction d = (state->dir + i) & 3;
+    if (opposites(state->dir, d)) continue;
+    struct point p = neighbour(head, d);
+    int far = abs(p.row - state->food.row) + abs(p.col - state->food.col);
+    for (j=n; j>0 && distance[j-1] > far; j--) {
+      order[j] = order[j-1];
+      distance[j] = distance[j-1];
+    }
+    order[j] = d;
+    distance[j] = far;
+    n++;
+  }
+}
+
+/*  Pick a move without a plan: the first towards the food which leaves
+    enough room, or else the one with the most room. If the time runs out,
+    it's the best move looked at so far, or the first free one, so the
+    snake keeps closing on the food even while every search is cut short.
+    Keeps going the same way if nothing is free. */
+static Direction
+fallback (struct autopilot *pilot, struct game_state *state, int64_t deadline)
+{
+  struct snake *snake = state->snake;
+  struct point head = snake_head(snake);
+  Direction order[3];
+  moves_toward_food(state, order);
+  Direction best = state->dir;
+  long int bestRoom = OUT_OF_TIME;
+  int i;
+  for (i=0; i<3; i++) {
+    struct point p = neighbour(head, order[i]);
+    if (!is_free(pilot, snake, p)) continue;
+    long int room = flood(pilot, snake, p, snake->length, deadline);
+    if (room == OUT_OF_TIME) {
+      if (bestRoom == OUT_OF_TIME) best = order[i];
+      break;
+    }
+    if (room > bestRoom) {
+      best = order[i];
+      bestRoom = room;
+    }
+    if (room >= snake->length) break;
+  }
+  return best;
+}
+
+/*  Decide which way the snake goes, as autopilot_next describes. */
+static Direction
+decide (struct autopilot *pilot, struct game_state *state, int64_t deadline)
+{
+  struct snake *snake = state->snake;
+  struct point head = snake_head(snake);
+
+  // Keep to the plan while its next move still leaves room, or if there's
+  // no time to check.
+  if (plan_open(pilot, state)) {
+    Direction d = pilot->plan[pilot->plan_at];
+    long int room = flood(pilot, snake, neighbour(head, d), snake->length, deadline);
+    if (room == OUT_OF_TIME || room >= snake->length) {
+      pilot->plan_at++;
+      return d;
+    }
+  }
+
+  // Otherwise find a new way to the food, and take it if the first move
+  // leaves room.
+  int found = pilot->max_layers > 0 ? search(pilot, state, deadline) : 0;
+  if (found == 1) {
+    long int room = flood(pilot, snake, neighbour(head, pilot->plan[0]), snake->length, deadline);
+    if (room == OUT_OF_TIME || room >= snake->length) {
+      pilot->plan_at = 1;
+      return pilot->plan[0];
+    }
+  }
+
+  // No safe way was found in time.
+  pilot->fallbacks++;
+  pilot->plan_len = pilot->plan_at = 0;
+  return fallback(pilot, state, deadline);
+}
+
+
+
+// ------------------------------------------------------------
+// Autopilot functions.
+// ------------------------------------------------------------
+
+/*  Set up an autopilot for games on a board, as config says. Everything
+    it uses comes from the arena. A board with no Hamiltonian cycle is
+    searched instead. On an unbounded board, which has no bits to search,
+    it only heads for the food without running into the snake. Frontiers
+    are grown with AVX2 if the CPU has it. */
+void
+init_autopilot (struct autopilot *pilot, struct arena *arena,
+                struct game_data *game, struct pilot_config *config)
+{
+  memset(pilot, 0, sizeof *pilot);
+  pilot->game = game;
+  pilot->budget_ns = (int64_t) config->budget_us * 1000;
+  if (config->cycle && init_hamilton(&pilot->cycle, arena, game)) {
+    pilot->follow_cycle = 1;
+    return;
+  }
+#ifdef HAVE_X86
+  pilot->avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+  if (game->unbounded) return;
+
+  pilot->rows = game->WALL_HT;
+  pilot->words_per_row = (game->WALL_WD + 63) / 64;
+  pilot->board_words = (size_t) pilot->rows * pilot->words_per_row;
+  size_t bytes = pilot->board_words * sizeof (uint64_t);
+  pilot->open = arena_calloc(arena, bytes);
+  pilot->visited = arena_calloc(arena, bytes);
+  pilot->front = arena_calloc(arena, bytes);
+  pilot->next = arena_calloc(arena, bytes);
+  pilot->zero = arena_calloc(arena, pilot->words_per_row * sizeof (uint64_t));
+  int r, c;
+  for (r=1; r<game->WALL_HT-1; r++) {
+    for (c=1; c<game->WALL_WD-1; c++) {
+      pilot->open[(size_t) r * pilot->words_per_row + (c >> 6)] |= (uint64_t) 1 << (c & 63);
+    }
+  }
+
+  // A path never has more steps than the board has cells, so there's no
+  // use in more layers than that.
+  long int cells = (long int) (game->WALL_HT - 2) * (game->WALL_WD - 2);
+  long int fit = AUTOPILOT_LAYER_BYTES / bytes;
+  pilot->max_layers = fit < cells + 1 ? fit : cells + 1;
+  if (pilot->max_layers < 2) pilot->max_layers = 0;
+  if (pilot->max_layers > 0) {
+    pilot->layers = arena_alloc(arena, pilot->max_layers * bytes);
+    pilot->layer_lo = arena_alloc(arena, pilot->max_layers * sizeof (int));
+    pilot->layer_hi = arena_alloc(arena, pilot->max_layers * sizeof (int));
+    pilot->plan = arena_alloc(arena, pilot->max_layers * sizeof (Direction));
+  }
+}
+
+/*  Decide which way the snake goes this step, counting the decision as an
+    overrun if it took longer than the budget. */
+Direction
+autopilot_next (struct autopilot *pilot, struct game_state *state)
+{
+  struct snake *snake = state->snake;
+  pilot->decisions++;
+  if (pilot->follow_cycle) return hamilton_next(&pilot->cycle, state);
+
+  // Without bits to search, take the move nearest the food that doesn't
+  // run into the snake.
+  if (pilot->rows == 0) {
+    Direction order[3];
+    moves_toward_food(state, order);
+    int i;
+    for (i=0; i<3; i++) {
+      struct point p = new_pos(state->game, snake, order[i]);
+      if (!touching(snake, &p)) return order[i];
+    }
+    return state->dir;
+  }
+
+  int64_t deadline = now_ns() + pilot->budget_ns;
+  pilot->words_grown = 0;
+  Direction d = decide(pilot, state, deadline);
+  if (now_ns() > deadline) pilot->overruns++;
+  return d;
+}
@@ -0,0 +1,105 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "game.h"
+#include "hamilton.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// how long the autopilot has to decide each move, by default; enough for
+// a build without optimisation to finish nearly every search on a board
+// of 100 by 100
+#define DEFAULT_AUTOPILOT_US 1000
+
+// most memory the layers of a search can take; a board too big for two
+// layers in this much is never searched
+#define AUTOPILOT_LAYER_BYTES (8 * 1024 * 1024)
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// How the snake plays itself: by searching for the food, with budget_us
+// microseconds to decide each move, or if cycle is set, by following a
+// Hamiltonian cycle of the board, if it has one.
+struct pilot_config {
+  int budget_us;
+  int cycle;
+};
+
+// Plays the snake on a bounded board. Sets of cells are bit boards laid out
+// like the snake's own bits, rows of words_per_row words, so a whole
+// breadth-first search layer is grown with a few shifts and ANDs a word.
+//
+// To find the food it searches outward from the food over the free cells,
+// keeping each layer, until it reaches a cell next to the head; walking
+// back down the layers gives a shortest path, which becomes the plan. A
+// move is only taken if a flood fill from where it leads can reach the
+// tail or at least as many cells as the snake is long, so the snake
+// doesn't shut itself in.
+//
+// Every decision has budget_ns to run in. The next move of the plan is
+// checked with a flood fill each step, since the snake may have grown
+// across what was room before; if the check runs out of time the move is
+// made anyway, the plan being the last one known to be safe. If there is
+// no plan to follow, and a search runs out of time or finds nothing safe,
+// the snake makes the first move towards the food with enough room, or
+// the one with the most, as far as there's time to tell. decisions,
+// searches, overruns and fallbacks count how often each of those
+// happened, an overrun being a decision which took longer than its budget
+// and so had its search cut short.
+//
+// words_grown counts the words of frontiers grown since the clock was
+// last read. avx2 is set if frontiers can be grown with AVX2. open holds
+// the cells inside the walls, and zero is a row with nothing in it.
+// visited, front and next are scratch bit boards, and layers has room for
+// max_layers layers of a search, layer k having cells only in rows
+// [layer_lo[k], layer_hi[k]]. The plan is plan_len moves to plan_food, of
+// which plan_at have been made.
+//
+// If follow_cycle is set, the snake follows cycle instead, and nothing
+// else is used.
+struct autopilot {
+  struct game_data *game;
+  int rows;
+  int words_per_row;
+  size_t board_words;
+  int64_t budget_ns;
+  long int words_grown;
+  int avx2;
+  uint64_t *open;
+  uint64_t *zero;
+  uint64_t *visited;
+  uint64_t *front;
+  uint64_t *next;
+  uint64_t *layers;
+  int *layer_lo;
+  int *layer_hi;
+  int max_layers;
+  Direction *plan;
+  int plan_len;
+  int plan_at;
+  struct point plan_food;
+  long int decisions;
+  long int searches;
+  long int overruns;
+  long int fallbacks;
+  int follow_cycle;
+  struct hamilton cycle;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+void init_autopilot (struct autopilot *pilot, struct arena *arena,
+                     struct game_data *game, struct pilot_config *config);
+Direction autopilot_next (struct autopilot *pilot, struct game_state *state);
+
+#endif
@@ -0,0 +1,908 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <ncurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "autopilot.h"
+#include "draw.h"
+#include "game.h"
+#include "hamilton.h"
+#include "minimap.h"
+#include "render.h"
+#include "save.h"
+#include "sim.h"
+#include "snapshot.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// a benchmark keeps doubling its number of ops until a run takes this long
+#define BENCH_MIN_NS 100e6
+
+// number of random points looked up by the touching benchmark
+#define NUM_PROBES 4096
+
+// side of the square board used by the fixed-size benchmarks
+#define BOARD_SIDE 64
+
+// size of the view of a board too big to see all at once
+#define VIEW_HT 24
+#define VIEW_WD 40
+
+
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// Time, heap allocations, and writes and bytes written, spent inside
+// the measured part of a run.
+struct sample {
+  double ns;
+  long int allocs;
+  long int writes;
+  long int bytes;
+  double start_ns;
+  long int start_allocs;
+  long int start_writes;
+  long int start_bytes;
+};
+
+// Runs n operations of a benchmark, measuring only the parts it brackets
+// with start_sample and stop_sample.
+typedef void (*bench_fn) (void *ctx, long int n, struct sample *sample);
+
+// A segment of the snake as it was before the ring buffer: a linked list
+// with each point allocated on its own, kept to compare against.
+struct list_snake {
+  struct point *loc;
+  struct list_snake *next;
+};
+
+// A square board with a Hamiltonian cycle around its interior, and a
+// snake which follows it. at is the index of the cell the head is on.
+// The snake is allocated from the board's arena. camera is where the
+// view of the board in its snapshots starts.
+struct board {
+  struct game_data game;
+  struct arena arena;
+  struct point *cycle;
+  Direction *dirs;
+  int n;
+  struct snake *snake;
+  int at;
+  int length;
+  struct point food;
+  struct rng rng;
+  struct point probes[NUM_PROBES];
+  struct backend backend;
+  struct snapshot snap;
+  struct snapshot drawn;
+  struct point camera;
+};
+
+// A bit-packed board of side rows by side cells, about half of them set,
+// to be summed up for a minimap with a kernel.
+struct bitset {
+  int side;
+  int words_per_row;
+  uint64_t *bits;
+  uint64_t *counts;
+  struct popcount_kernel *kernel;
+  struct minimap map;
+};
+
+
+
+// ------------------------------------------------------------
+// Allocation counting.
+// ------------------------------------------------------------
+
+// Every call to malloc, calloc or realloc made by the process, including
+// those made inside ncurses, goes through these wrappers.
+long int allocations = 0;
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t num, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+void *malloc (size_t size)
+{
+  allocations++;
+  return __libc_malloc(size);
+}
+
+void *calloc (size_t num, size_t size)
+{
+  allocations++;
+  return __libc_calloc(num, size);
+}
+
+void *realloc (void *ptr, size_t size)
+{
+  allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+
+
+// ------------------------------------------------------------
+// Write counting.
+// ------------------------------------------------------------
+
+// Every call to write made by the process, including those ncurses makes
+// to send a refresh, goes through this wrapper.
+long int writes = 0;
+long int bytes_out = 0;
+
+extern ssize_t __write (int fd, const void *buf, size_t count);
+
+ssize_t write (int fd, const void *buf, size_t count)
+{
+  writes++;
+  ssize_t n = __write(fd, buf, count);
+  if (n > 0) bytes_out += n;
+  return n;
+}
+
+
+
+// ------------------------------------------------------------
+// Measurement.
+// ------------------------------------------------------------
+
+/*  Get the time on the monotonic clock in nanoseconds. */
+static double
+now_ns (void)
+{
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return tp.tv_sec * 1e9 + tp.tv_nsec;
+}
+
+static void
+start_sample (struct sample *sample)
+{
+  sample->start_allocs = allocations;
+  sample->start_writes = writes;
+  sample->start_bytes = bytes_out;
+  sample->start_ns = now_ns();
+}
+
+static void
+stop_sample (struct sample *sample)
+{
+  sample->ns += now_ns() - sample->start_ns;
+  sample->allocs += allocations - sample->start_allocs;
+  sample->writes += writes - sample->start_writes;
+  sample->bytes += bytes_out - sample->start_bytes;
+}
+
+// If set, how many board cells each op of the running benchmark covers,
+// so that its throughput can be reported too.
+long int cells_per_op = 0;
+
+/*  Run a benchmark with more and more ops until it takes long enough to
+    time, then print its result as a JSON object. */
+static void
+run_bench (char *name, char *param_name, long int param, bench_fn fn, void *ctx)
+{
+  static int first = 1;
+  struct sample sample;
+  long int n = 1;
+  while (1) {
+    sample.ns = 0;
+    sample.allocs = 0;
+    sample.writes = 0;
+    sample.bytes = 0;
+    fn(ctx, n, &sample);
+    if (sample.ns >= BENCH_MIN_NS) break;
+    n *= 2;
+  }
+
+  printf("%s\n    {\"name\": \"%s\", \"%s\": %ld, \"ops\": %ld, "
+         "\"ns_per_op\": %.3f, \"allocs_per_op\": %.4f, "
+         "\"writes_per_op\": %.4f, \"bytes_per_op\": %.1f",
+         first ? "" : ",", name, param_name, param, n,
+         sample.ns / n, (double) sample.allocs / n,
+         (double) sample.writes / n, (double) sample.bytes / n);
+  if (cells_per_op > 0) {
+    printf(", \"cells_per_ns\": %.1f", cells_per_op * n / sample.ns);
+  }
+  printf("}");
+  first = 0;
+  fflush(stdout);
+}
+
+
+
+// ------------------------------------------------------------
+// Boards.
+// ------------------------------------------------------------
+
+/*  Build a cycle which visits every cell of a side*side square exactly once,
+    starting at (1,1). The snake can follow this cycle forever without
+    biting itself, so long as it is shorter than the cycle. side must be
+    even. The direction needed to step from cycle[i] to cycle[i+1] is stored
+    in dirs[i]. */
+static void
+make_cycle (int side, struct point *cycle, Direction *dirs)
+{
+  int n = side * side;
+  int i = 0, row, col;
+
+  // Across the top row, then zig-zag down through every column but the
+  // first, then back up the first column.
+  for (col=1; col<=side; col++) {
+    cycle[i].row = 1; cycle[i++].col = col;
+  }
+  for (row=2; row<=side; row++) {
+    if (row % 2 == 0) {
+      for (col=side; col>=2; col--) { cycle[i].row = row; cycle[i++].col = col; }
+    }
+    else {
+      for (col=2; col<=side; col++) { cycle[i].row = row; cycle[i++].col = col; }
+    }
+  }
+  for (row=side; row>=2; row--) {
+    cycle[i].row = row; cycle[i++].col = 1;
+  }
+
+  for (i=0; i<n; i++) {
+    struct point a = cycle[i];
+    struct point b = cycle[(i+1) % n];
+    if (b.row < a.row) dirs[i] = NORTH;
+    else if (b.row > a.row) dirs[i] = SOUTH;
+    else if (b.col < a.col) dirs[i] = WEST;
+    else dirs[i] = EAST;
+  }
+}
+
+/*  Lay a snake of the given length along the start of the board's cycle,
+    tail first, replacing any snake which was there. */
+static struct snake *
+lay_snake (struct board *board, int length)
+{
+  reset_arena(&board->arena);
+  struct snake *snake = init_snake(&board->arena, &board->game,
+                                   board->cycle[0].row, board->cycle[0].col);
+  int i;
+  for (i=1; i<length; i++) grow_snake(&board->game, snake, board->cycle[i]);
+  board->at = length - 1;
+  return snake;
+}
+
+/*  Make a board with a side*side interior (rounded up to be even) holding
+    a snake of the given length, with food on a free cell if there is
+    one. */
+static void
+init_board (struct board *board, int side, int length)
+{
+  if (side % 2) side++;
+  board->n = side * side;
+  board->cycle = malloc(board->n * sizeof (struct point));
+  board->dirs = malloc(board->n * sizeof (Direction));
+  make_cycle(side, board->cycle, board->dirs);
+
+  struct game_data game = { .WALL_HT = side + 2, .WALL_WD = side + 2 };
+  board->game = game;
+  init_arena(&board->arena, ARENA_BLOCK_SIZE);
+  board->length = length;
+  board->snake = lay_snake(board, length);
+  board->camera.row = 0;
+  board->camera.col = 0;
+  seed_rng(&board->rng, 1);
+  randomise_food(&board->game, board->snake, &board->rng, &board->food);
+
+  int i;
+  for (i=0; i<NUM_PROBES; i++) {
+    board->probes[i].row = 1 + rng_below(&board->rng, side);
+    board->probes[i].col = 1 + rng_below(&board->rng, side);
+  }
+}
+
+/*  Make a board big enough for a snake of the given length to keep moving
+    around it. */
+static void
+init_board_for (struct board *board, int length)
+{
+  int side = 2;
+  while (side * side < length + 2) side += 2;
+  init_board(board, side, length);
+}
+
+static void
+free_board (struct board *board)
+{
+  free_arena(&board->arena);
+  free(board->cycle);
+  free(board->dirs);
+}
+
+/*  Take a snapshot of the board, with its view following the head as
+    the thread playing a game does. */
+static void
+take_snapshot (struct board *board, struct snapshot *snap)
+{
+  board->camera = follow_head(board->camera, snap, snake_head(board->snake), &board->game);
+  fill_snapshot(snap, board->snake, board->food, board->camera);
+}
+
+/*  Move the snake one cell further round the cycle. */
+static inline void
+advance (struct board *board)
+{
+  int next = (board->at + 1) % board->n;
+  move_snake(&board->game, board->snake, board->cycle[next]);
+  board->at = next;
+}
+
+
+
+// ------------------------------------------------------------
+// Baseline.
+// ------------------------------------------------------------
+
+/*  Lay a linked-list snake along the board's cycle as lay_snake does, the
+    head on the cell the board's snake has its head on. Each segment and
+    its point are allocated separately, as they used to be. */
+static struct list_snake *
+lay_list (struct board *board)
+{
+  struct list_snake *head = NULL;
+  int i;
+  for (i=board->length-1; i>=0; i--) {
+    struct list_snake *segment = malloc(sizeof (struct list_snake));
+    segment->loc = malloc(sizeof (struct point));
+    *segment->loc = board->cycle[(board->at - i + board->n) % board->n];
+    segment->next = head;
+    head = segment;
+  }
+  return head;
+}
+
+static void
+free_list (struct list_snake *head)
+{
+  while (head != NULL) {
+    struct list_snake *next = head->next;
+    free(head->loc);
+    free(head);
+    head = next;
+  }
+}
+
+/*  Move a linked-list snake the old way, rewriting every segment. */
+static void
+move_list (struct list_snake *head, struct point p)
+{
+  while (head != NULL) {
+    struct point was = *head->loc;
+    *head->loc = p;
+    p = was;
+    head = head->next;
+  }
+}
+
+/*  Check whether any segment of a linked-list snake is on a point. */
+static int
+touching_list (struct list_snake *head, struct point *p)
+{
+  for (; head != NULL; head = head->next) {
+    if (head->loc->row == p->row && head->loc->col == p->col) return 1;
+  }
+  return 0;
+}
+
+
+
+// ------------------------------------------------------------
+// Benchmarks.
+// ------------------------------------------------------------
+
+/*  A whole step without food: new_pos, move_snake and the self-collision
+    check. */
+static void
+bench_tick (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    struct point p = new_pos(&board->game, board->snake, board->dirs[board->at]);
+    move_snake(&board->game, board->snake, p);
+    if (bitten(board->snake)) {
+      fprintf(stderr, "snake bit itself during benchmark\n");
+      exit(1);
+    }
+    board->at = (board->at + 1) % board->n;
+  }
+  stop_sample(sample);
+}
+
+/*  The step bench_tick times, with the linked-list snake the ring buffer
+    replaced: the baseline the tick numbers are measured against. */
+static void
+bench_tick_list (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  struct list_snake *head = lay_list(board);
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    struct point p = *head->loc;
+    switch (board->dirs[board->at]) {
+      case NORTH: p.row--; break;
+      case SOUTH: p.row++; break;
+      case WEST: p.col--; break;
+      case EAST: p.col++; break;
+    }
+    move_list(head, p);
+    if (touching_list(head->next, head->loc)) {
+      fprintf(stderr, "snake bit itself during benchmark\n");
+      exit(1);
+    }
+    board->at = (board->at + 1) % board->n;
+  }
+  stop_sample(sample);
+  free_list(head);
+}
+
+static void
+bench_move_snake (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) advance(board);
+  stop_sample(sample);
+}
+
+/*  Grow snakes from one segment up to the board's length. Only the calls
+    to grow_snake are measured, so this is the amortised cost of a grow,
+    including the ring buffer doubling. */
+static void
+bench_grow_snake (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  long int done = 0;
+  while (done < n) {
+    board->snake = lay_snake(board, 1);
+    long int i, batch = board->length - 1;
+    if (batch > n - done) batch = n - done;
+    if (batch < 1) batch = 1;
+    start_sample(sample);
+    for (i=0; i<batch; i++) {
+      grow_snake(&board->game, board->snake, board->cycle[i+1]);
+    }
+    stop_sample(sample);
+    done += batch;
+  }
+}
+
+static void
+bench_new_pos (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  volatile int sink = 0;
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    struct point p = new_pos(&board->game, board->snake, (Direction) (i & 3));
+    sink += p.row;
+  }
+  stop_sample(sample);
+}
+
+static void
+bench_touching (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  volatile int sink = 0;
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    sink += touching(board->snake, &board->probes[i & (NUM_PROBES - 1)]);
+  }
+  stop_sample(sample);
+}
+
+static void
+bench_randomise_food (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    randomise_food(&board->game, board->snake, &board->rng, &board->food);
+  }
+  stop_sample(sample);
+}
+
+/*  Play whole headless games one after another on the board's size, with
+    the random policy, reusing one arena as a batch worker does. */
+static void
+bench_play_headless (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  struct game_result result;
+  long int i;
+
+  // Warm the arena up first, so only the steady state is measured.
+  play_headless(&board->arena, &board->game, 0, NULL, NULL, 100000, &result);
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    play_headless(&board->arena, &board->game, i, NULL, NULL, 100000, &result);
+  }
+  stop_sample(sample);
+}
+
+/*  Redraw the whole board from scratch, as happens after a resize. */
+static void
+bench_render_full (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  struct backend *backend = &board->backend;
+  struct damage damage = { .num_cells = 0, .full = 1 };
+  long int i;
+  take_snapshot(board, &board->snap);
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    backend->resize(backend, LINES, COLS);
+    damage.full = 1;
+    draw_damage(&damage, &board->game, &board->snap, backend);
+    backend->present(backend);
+  }
+  stop_sample(sample);
+}
+
+/*  Move the snake, take a snapshot of it, and draw just the cells that
+    changed since the last one, as the two threads of play_game do every
+    step. */
+static void
+bench_render_step (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  struct damage damage = { .num_cells = 0, .full = 0 };
+  take_snapshot(board, &board->drawn);
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    advance(board);
+    take_snapshot(board, &board->snap);
+    mark_changes(&damage, &board->drawn, &board->snap);
+    draw_damage(&damage, &board->game, &board->snap, &board->backend);
+    board->backend.present(&board->backend);
+  }
+  stop_sample(sample);
+}
+
+
+/*  Resume a game from a save file of the board, as choosing "Resume" from
+    the menu does. */
+static void
+bench_resume (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  struct game_state state;
+  state.game = &board->game;
+  state.snake = board->snake;
+  state.food = board->food;
+  state.dir = board->dirs[board->at];
+  state.ate_food = 0;
+  state.score = board->length;
+  state.ticks = board->length;
+  state.rng = board->rng;
+
+  char path[] = "/tmp/snake-bench-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0 || !save_game(&state, path)) {
+    fprintf(stderr, "could not save a game for benchmark\n");
+    exit(1);
+  }
+  close(fd);
+
+  struct arena arena;
+  init_arena(&arena, ARENA_BLOCK_SIZE);
+  struct game_data game;
+  struct save_file save;
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    reset_arena(&arena);
+    if (!load_game(&save, path, &state, &game, &arena)) {
+      fprintf(stderr, "could not resume a game for benchmark\n");
+      exit(1);
+    }
+    close_save(&save);
+  }
+  stop_sample(sample);
+  free_arena(&arena);
+  unlink(path);
+}
+
+/*  Decide the autopilot's next move from scratch, searching for the food
+    and checking the move leaves room, with time enough never to run out. */
+static void
+bench_autopilot (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  struct game_state state;
+  state.game = &board->game;
+  state.snake = board->snake;
+  state.food = board->food;
+  state.dir = board->dirs[board->at];
+  struct autopilot pilot;
+  struct pilot_config config = { 1000000, 0 };
+  init_autopilot(&pilot, &board->arena, &board->game, &config);
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    pilot.plan_len = 0;
+    autopilot_next(&pilot, &state);
+  }
+  stop_sample(sample);
+}
+
+/*  Decide a move around a Hamiltonian cycle, which should cost the same
+    however big the board is. */
+static void
+bench_cycle_next (void *ctx, long int n, struct sample *sample)
+{
+  struct board *board = ctx;
+  struct game_state state;
+  state.game = &board->game;
+  state.snake = board->snake;
+  state.food = board->food;
+  state.dir = board->dirs[board->at];
+  state.ate_food = 0;
+  struct hamilton cycle;
+  init_hamilton(&cycle, &board->arena, &board->game);
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) hamilton_next(&cycle, &state);
+  stop_sample(sample);
+}
+
+/*  Set up the Hamiltonian cycle of a board, which is a table on boards up
+    to MAX_CYCLE_TABLE_CELLS and arithmetic past that. */
+static void
+bench_cycle_init (void *ctx, long int n, struct sample *sample)
+{
+  struct game_data *game = ctx;
+  struct arena arena;
+  init_arena(&arena, ARENA_BLOCK_SIZE);
+  struct hamilton cycle;
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    reset_arena(&arena);
+    init_hamilton(&cycle, &arena, game);
+  }
+  stop_sample(sample);
+  free_arena(&arena);
+}
+
+/*  Sum up a whole bit-packed board for a minimap, every band of it
+    having been touched. */
+static void
+bench_minimap (void *ctx, long int n, struct sample *sample)
+{
+  struct bitset *set = ctx;
+  long int i;
+  start_sample(sample);
+  for (i=0; i<n; i++) {
+    set->map.dirty = ((uint32_t) 1 << set->map.rows) - 1;
+    summarise_board(&set->map, set->kernel, set->bits, set->words_per_row,
+                    set->side, set->side / 2, set->side / 2, set->counts);
+  }
+  stop_sample(sample);
+}
+
+
+
+// ------------------------------------------------------------
+// Main.
+// ------------------------------------------------------------
+
+/*  Run one benchmark against a snake of each length. */
+static void
+by_length (char *name, bench_fn fn, int *lengths, int num_lengths)
+{
+  int i;
+  for (i=0; i<num_lengths; i++) {
+    struct board board;
+    init_board_for(&board, lengths[i]);
+    run_bench(name, "length", lengths[i], fn, &board);
+    free_board(&board);
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  int lengths[] = { 16, 256, 4096, 65536 };
+  int num_lengths = sizeof(lengths) / sizeof(lengths[0]);
+  int fills[] = { 0, 25, 50, 75, 90, 99 };
+  int num_fills = sizeof(fills) / sizeof(fills[0]);
+  int sides[] = { 20, BOARD_SIDE };
+  int num_sides = sizeof(sides) / sizeof(sides[0]);
+  int i;
+
+  printf("{\n  \"benchmarks\": [");
+
+  by_length("tick", bench_tick, lengths, num_lengths);
+  by_length("tick_list", bench_tick_list, lengths, num_lengths);
+
+  // The same, with the board's cells kept in chunks as on an unbounded
+  // board.
+  for (i=0; i<num_lengths; i++) {
+    struct board board;
+    init_board_for(&board, lengths[i]);
+    board.game.unbounded = 1;
+    board.snake = lay_snake(&board, lengths[i]);
+    run_bench("tick_unbounded", "length", lengths[i], bench_tick, &board);
+    free_board(&board);
+  }
+  by_length("move_snake", bench_move_snake, lengths, num_lengths);
+  by_length("grow_snake", bench_grow_snake, lengths, num_lengths);
+
+  struct board board;
+  init_board(&board, BOARD_SIDE, BOARD_SIDE * BOARD_SIDE / 2);
+  run_bench("new_pos", "length", board.length, bench_new_pos, &board);
+  run_bench("touching", "length", board.length, bench_touching, &board);
+  free_board(&board);
+
+  // Food placement with the board from empty to nearly full.
+  for (i=0; i<num_fills; i++) {
+    int length = BOARD_SIDE * BOARD_SIDE * fills[i] / 100;
+    init_board(&board, BOARD_SIDE, length < 1 ? 1 : length);
+    run_bench("randomise_food", "fill_percent", fills[i], bench_randomise_food, &board);
+    free_board(&board);
+  }
+
+  // Resuming saved games, which should cost much the same however long
+  // the snake is.
+  int resume_lengths[] = { 256, 4096, 100000 };
+  int num_resume_lengths = sizeof(resume_lengths) / sizeof(resume_lengths[0]);
+  for (i=0; i<num_resume_lengths; i++) {
+    init_board_for(&board, resume_lengths[i]);
+    run_bench("resume", "length", resume_lengths[i], bench_resume, &board);
+    free_board(&board);
+  }
+
+  // Autopilot decisions with a quarter of the board taken, on boards up to
+  // bigger than a word is wide.
+  int pilot_sides[] = { 20, BOARD_SIDE, 256, 1024 };
+  int num_pilot_sides = sizeof(pilot_sides) / sizeof(pilot_sides[0]);
+  for (i=0; i<num_pilot_sides; i++) {
+    init_board(&board, pilot_sides[i], pilot_sides[i] * pilot_sides[i] / 4);
+    run_bench("autopilot", "side", pilot_sides[i], bench_autopilot, &board);
+    free_board(&board);
+  }
+
+  // Following a Hamiltonian cycle: setting it up, which grows with the
+  // board until it's too big for a table, and deciding each move, which
+  // doesn't.
+  int cycle_sides[] = { 256, 1024, 2048, 4096, 10000 };
+  int num_cycle_sides = sizeof(cycle_sides) / sizeof(cycle_sides[0]);
+  for (i=0; i<num_cycle_sides; i++) {
+    struct game_data game = { .WALL_HT = cycle_sides[i] + 2, .WALL_WD = cycle_sides[i] + 2 };
+    run_bench("cycle_init", "side", cycle_sides[i], bench_cycle_init, &game);
+  }
+  for (i=0; i<num_pilot_sides; i++) {
+    init_board(&board, pilot_sides[i], pilot_sides[i] * pilot_sides[i] / 4);
+    run_bench("cycle_next", "side", pilot_sides[i], bench_cycle_next, &board);
+    free_board(&board);
+  }
+
+  // Whole games, which after warmup should never touch the heap.
+  init_board(&board, 18, 1);
+  run_bench("play_headless", "side", 18, bench_play_headless, &board);
+  free_board(&board);
+
+  // Rendering with each backend, into a terminal big enough for the board
+  // whose output goes nowhere. The null backend times deciding what to
+  // draw on its own, and the frame backend drawing into memory.
+  setenv("LINES", "100", 1);
+  setenv("COLUMNS", "100", 1);
+  FILE *out = fopen("/dev/null", "w");
+  FILE *in = fopen("/dev/null", "r");
+  SCREEN *screen = newterm("xterm-256color", out, in);
+  if (screen == NULL) {
+    fprintf(stderr, "could not start a null terminal\n");
+    return 1;
+  }
+  start_color();
+  curses_init_colours();
+  char *backends[] = { "curses", "ansi", "null", "frame" };
+  int num_backends = sizeof(backends) / sizeof(backends[0]);
+  int b;
+  for (b=0; b<num_backends; b++) {
+    char full_name[32], step_name[32];
+    snprintf(full_name, sizeof full_name, "render_full_%s", backends[b]);
+    snprintf(step_name, sizeof step_name, "render_step_%s", backends[b]);
+    for (i=0; i<num_sides; i++) {
+      init_board(&board, sides[i], sides[i] * sides[i] / 2);
+      WINDOW *window = NULL;
+      struct ansi_screen ansi;
+      struct null_counts counts;
+      struct frame_buffer frame;
+      if (b == 0) {
+        window = newwin(0, 0, 0, 0);
+        init_curses_backend(&board.backend, window);
+      }
+      else if (b == 1) init_ansi_backend(&board.backend, &ansi, fileno(out), LINES, COLS);
+      else if (b == 2) init_null_backend(&board.backend, &counts);
+      else init_frame_backend(&board.backend, &frame, NULL, LINES, COLS);
+      init_snapshot(&board.snap, &board.arena, &board.game);
+      init_snapshot(&board.drawn, &board.arena, &board.game);
+      run_bench(full_name, "side", sides[i], bench_render_full, &board);
+      run_bench(step_name, "side", sides[i], bench_render_step, &board);
+      board.backend.close(&board.backend);
+      if (window != NULL) delwin(window);
+      free_board(&board);
+    }
+  }
+
+  // Rendering a view of boards far bigger than the terminal, which should
+  // cost the same however big the board and the snake are.
+  int big_sides[] = { 64, 512, 2048 };
+  int num_big_sides = sizeof(big_sides) / sizeof(big_sides[0]);
+  for (i=0; i<num_big_sides; i++) {
+    init_board(&board, big_sides[i], big_sides[i] * big_sides[i] / 2);
+    board.game.view_ht = VIEW_HT;
+    board.game.view_wd = VIEW_WD;
+    struct ansi_screen ansi;
+    init_ansi_backend(&board.backend, &ansi, fileno(out), LINES, COLS);
+    init_snapshot(&board.snap, &board.arena, &board.game);
+    init_snapshot(&board.drawn, &board.arena, &board.game);
+    run_bench("render_view_ansi", "side", big_sides[i], bench_render_step, &board);
+    board.backend.close(&board.backend);
+    free_board(&board);
+  }
+  endwin();
+  delscreen(screen);
+
+  // Summing up boards for a minimap with each popcount kernel the CPU can
+  // run, at sizes up to the biggest board there can be.
+  int bit_sides[] = { 1024, 4096, 10000 };
+  int num_bit_sides = sizeof(bit_sides) / sizeof(bit_sides[0]);
+  int k;
+  for (k=0; k<num_popcount_kernels; k++) {
+    struct popcount_kernel *kernel = &popcount_kernels[k];
+    if (!kernel->supported()) continue;
+    char name[32];
+    snprintf(name, sizeof name, "minimap_%s", kernel->name);
+    for (i=0; i<num_bit_sides; i++) {
+      struct bitset set;
+      set.side = bit_sides[i];
+      set.words_per_row = (set.side + 63) / 64;
+      set.bits = malloc((size_t) set.side * set.words_per_row * sizeof (uint64_t));
+      set.counts = malloc(set.words_per_row * sizeof (uint64_t));
+      set.kernel = kernel;
+      struct rng rng;
+      seed_rng(&rng, 1);
+      size_t w;
+      for (w=0; w<(size_t) set.side * set.words_per_row; w++) {
+        set.bits[w] = ((uint64_t) rng_next(&rng) << 32) | rng_next(&rng);
+      }
+      init_minimap(&set.map, set.side, set.side);
+      cells_per_op = (long int) set.side * set.side;
+      run_bench(name, "side", set.side, bench_minimap, &set);
+      cells_per_op = 0;
+      free(set.counts);
+      free(set.bits);
+    }
+  }
+
+  printf("\n  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,216 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <string.h>
+
+#include "chunk.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// the chunk a cell coordinate falls in, and where in the chunk it is;
+// both work for negative coordinates too
+#define CHUNK_OF(X) ((X) >> CHUNK_BITS)
+#define WITHIN(X) ((X) & (CHUNK_SIDE - 1))
+
+
+
+// ------------------------------------------------------------
+// Hash table functions.
+// ------------------------------------------------------------
+
+/*  Get the slot a chunk's coordinates hash to. */
+static inline int
+home_slot (struct chunk_map *map, int row, int col)
+{
+  uint64_t key = ((uint64_t) (uint32_t) row << 32) | (uint32_t) col;
+  key *= 0x9e3779b97f4a7c15ULL;
+  return (key >> 32) & (map->num_slots - 1);
+}
+
+/*  Get the slot holding the chunk at some chunk coordinates, or the empty
+    slot it would go in. */
+static int
+find_slot (struct chunk_map *map, int row, int col)
+{
+  int mask = map->num_slots - 1;
+  int i = home_slot(map, row, col);
+  while (map->slots[i] != NULL &&
+         (map->slots[i]->row != row || map->slots[i]->col != col)) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/*  Get the chunk at some chunk coordinates, or NULL if there isn't one. */
+static inline struct chunk *
+find_chunk (struct chunk_map *map, int row, int col)
+{
+  return map->slots[find_slot(map, row, col)];
+}
+
+/*  Double the size of the table. The old one stays in the arena, which
+    at most doubles the memory the table takes, and the table only grows
+    with the most chunks ever resident at once. */
+static void
+grow_table (struct chunk_map *map)
+{
+  struct chunk **old = map->slots;
+  int old_slots = map->num_slots;
+  map->num_slots *= 2;
+  map->slots = arena_calloc(map->arena, map->num_slots * sizeof (struct chunk *));
+  int i;
+  for (i=0; i<old_slots; i++) {
+    if (old[i] != NULL) map->slots[find_slot(map, old[i]->row, old[i]->col)] = old[i];
+  }
+}
+
+/*  Get the chunk at some chunk coordinates, making it if there isn't one.
+    Chunks the tail has left are reused before any more are allocated. */
+static struct chunk *
+make_chunk (struct chunk_map *map, int row, int col)
+{
+  int i = find_slot(map, row, col);
+  if (map->slots[i] != NULL) return map->slots[i];
+  if (2 * (map->resident + 1) > map->num_slots) {
+    grow_table(map);
+    i = find_slot(map, row, col);
+  }
+
+  struct chunk *chunk = map->free;
+  if (chunk != NULL) map->free = chunk->next_free;
+  else chunk = arena_alloc(map->arena, sizeof (struct chunk));
+  chunk->row = row;
+  chunk->col = col;
+  chunk->cells = 0;
+  memset(chunk->low, 0, sizeof chunk->low);
+  memset(chunk->high, 0, sizeof chunk->high);
+
+  map->slots[i] = chunk;
+  map->resident++;
+  if (map->resident > map->peak) map->peak = map->resident;
+  return chunk;
+}
+
+/*  Take an empty chunk out of the table and put it on the free list. The
+    chunks after it in its run are shifted back, so that lookups never
+    need to step over a hole. */
+static void
+evict_chunk (struct chunk_map *map, struct chunk *chunk)
+{
+  int mask = map->num_slots - 1;
+  int hole = find_slot(map, chunk->row, chunk->col);
+  int i = hole;
+  while (1) {
+    i = (i + 1) & mask;
+    struct chunk *next = map->slots[i];
+    if (next == NULL) break;
+
+    // next can fill the hole unless its home slot lies cyclically after
+    // the hole and at or before where it is now.
+    int home = home_slot(map, next->row, next->col);
+    int stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+    if (stays) continue;
+    map->slots[hole] = next;
+    hole = i;
+  }
+  map->slots[hole] = NULL;
+
+  chunk->next_free = map->free;
+  map->free = chunk;
+  map->resident--;
+}
+
+
+
+// ------------------------------------------------------------
+// Chunk map functions.
+// ------------------------------------------------------------
+
+/*  Set up an empty chunk map, allocating from the arena. */
+void
+init_chunk_map (struct chunk_map *map, struct arena *arena)
+{
+  map->arena = arena;
+  map->num_slots = CHUNK_MIN_SLOTS;
+  map->slots = arena_calloc(arena, CHUNK_MIN_SLOTS * sizeof (struct chunk *));
+  map->resident = 0;
+  map->peak = 0;
+  map->free = NULL;
+}
+
+/*  Get how many segments are on a cell. */
+int
+chunk_count (struct chunk_map *map, int row, int col)
+{
+  struct chunk *chunk = find_chunk(map, CHUNK_OF(row), CHUNK_OF(col));
+  if (chunk == NULL) return 0;
+  int r = WITHIN(row), c = WITHIN(col);
+  return ((chunk->low[r] >> c) & 1) | (((chunk->high[r] >> c) & 1) << 1);
+}
+
+/*  Add a segment to a cell, making its chunk if need be. */
+void
+chunk_add (struct chunk_map *map, int row, int col)
+{
+  struct chunk *chunk = make_chunk(map, CHUNK_OF(row), CHUNK_OF(col));
+  int r = WITHIN(row);
+  uint64_t bit = (uint64_t) 1 << WITHIN(col);
+  if (!(chunk->low[r] & bit)) {
+    if (!(chunk->high[r] & bit)) chunk->cells++;
+    chunk->low[r] |= bit;
+  }
+  else if (!(chunk->high[r] & bit)) {
+    chunk->low[r] &= ~bit;
+    chunk->high[r] |= bit;
+  }
+}
+
+/*  Take a segment off a cell which has one, evicting its chunk if that
+    leaves the chunk empty. */
+void
+chunk_remove (struct chunk_map *map, int row, int col)
+{
+  struct chunk *chunk = find_chunk(map, CHUNK_OF(row), CHUNK_OF(col));
+  if (chunk == NULL) return;
+  int r = WITHIN(row);
+  uint64_t bit = (uint64_t) 1 << WITHIN(col);
+  if (chunk->low[r] & bit) {
+    chunk->low[r] &= ~bit;
+    if (chunk->high[r] & bit) return;
+    if (--chunk->cells == 0) evict_chunk(map, chunk);
+  }
+  else if (chunk->high[r] & bit) {
+    chunk->high[r] &= ~bit;
+    chunk->low[r] |= bit;
+  }
+}
+
+/*  Copy which cells of a rows by cols window of the board, with its top
+    left at (row, col), have a segment on them into out, one byte a cell.
+    Each chunk the window covers is looked up once a row. */
+void
+chunk_window (struct chunk_map *map, int row, int col, int rows, int cols,
+              unsigned char *out)
+{
+  int r, c;
+  for (r=0; r<rows; r++) {
+    int y = row + r;
+    for (c=0; c<cols; ) {
+      int x = col + c;
+      int span = CHUNK_SIDE - WITHIN(x);
+      if (span > cols - c) span = cols - c;
+      struct chunk *chunk = find_chunk(map, CHUNK_OF(y), CHUNK_OF(x));
+      unsigned char *to = &out[r * cols + c];
+      if (chunk == NULL) memset(to, 0, span);
+      else {
+        uint64_t bits = (chunk->low[WITHIN(y)] | chunk->high[WITHIN(y)]) >> WITHIN(x);
+        int i;
+        for (i=0; i<span; i++) to[i] = (bits >> i) & 1;
+      }
+      c += span;
+    }
+  }
+}
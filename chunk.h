@@ -0,0 +1,65 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdint.h>
+
+#include "arena.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// chunks are CHUNK_SIDE cells square, so a row of one fits in a word
+#define CHUNK_BITS 6
+#define CHUNK_SIDE (1 << CHUNK_BITS)
+
+// slots in a new chunk map's table
+#define CHUNK_MIN_SLOTS 64
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// A square of an unbounded board, at chunk coordinates (row, col). The
+// number of segments on each of its cells is a two-bit count, kept as two
+// bit planes: bit c of low[r] and high[r] for the cell at (r, c) within
+// the chunk. Counts only go above one where the snake starts folded up
+// or has just bitten itself, and stop at three. cells is how many of its
+// cells have a segment on them.
+struct chunk {
+  int row;
+  int col;
+  int cells;
+  struct chunk *next_free;
+  uint64_t low[CHUNK_SIDE];
+  uint64_t high[CHUNK_SIDE];
+};
+
+// The chunks of an unbounded board which the snake is on, in a hash table
+// keyed by their coordinates, using linear probing. A chunk is made when
+// the head first enters it, and when the tail leaves it empty it goes on
+// a free list for the next chunk the head enters to reuse, so memory goes
+// with how much of the board the snake covers at once rather than how far
+// it has travelled. resident counts the chunks in the table, and peak the
+// most there have been.
+struct chunk_map {
+  struct chunk **slots;
+  int num_slots; // Always a power of two.
+  int resident;
+  int peak;
+  struct chunk *free;
+  struct arena *arena;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+void init_chunk_map (struct chunk_map *map, struct arena *arena);
+int chunk_count (struct chunk_map *map, int row, int col);
+void chunk_add (struct chunk_map *map, int row, int col);
+void chunk_remove (struct chunk_map *map, int row, int col);
+void chunk_window (struct chunk_map *map, int row, int col, int rows, int cols,
+                   unsigned char *out);
+
+#endif
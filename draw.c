@@ -0,0 +1,198 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <stdio.h>
+
+#include "draw.h"
+#include "game.h"
+#include "metrics.h"
+#include "snapshot.h"
+
+// ------------------------------------------------------------
+// Globals.
+// ------------------------------------------------------------
+
+// The column the HUD beside the board starts at.
+int hud_col = HUD_MIN_COL;
+
+
+
+// ------------------------------------------------------------
+// Drawing functions.
+// ------------------------------------------------------------
+
+/*  Draw the snake in a snapshot. Only the part of the board in view is
+    in the snapshot, so this costs the same however big the board or the
+    snake. */
+void draw_snake (struct snapshot *snap, struct backend *backend)
+{
+  int row, col;
+  for (row=0; row<snap->rows; row++) {
+    unsigned char *cells = &snap->cells[row * snap->cols];
+    for (col=0; col<snap->cols; col++) {
+      if (cells[col]) backend->put(backend, row, col, '*', COLOUR_SNAKE);
+    }
+  }
+}
+
+/*  Draw the food in a snapshot, if it's in view. */
+void draw_food (struct snapshot *snap, struct backend *backend)
+{
+  struct point food = snap->food;
+  if (!in_view(snap, food)) return;
+  backend->put(backend, food.row - snap->origin.row, food.col - snap->origin.col,
+               '*', COLOUR_FOOD);
+}
+
+/*  Draw the parts of the wall which are in a snapshot's view. An
+    unbounded board has none. */
+void draw_wall (struct game_data *game, struct snapshot *snap, struct backend *backend)
+{
+  struct point origin = snap->origin;
+  int i;
+  if (game->unbounded) return;
+
+  // draw the top and bottom edges
+  for (i=0; i<snap->cols; i++) {
+    if (origin.row == 0) backend->put(backend, 0, i, '*', COLOUR_WALL);
+    if (origin.row + snap->rows == game->WALL_HT) {
+      backend->put(backend, snap->rows-1, i, '*', COLOUR_WALL);
+    }
+  }
+
+  // draw the left and right edges
+  for (i=0; i<snap->rows; i++) {
+    if (origin.col == 0) backend->put(backend, i, 0, '*', COLOUR_WALL);
+    if (origin.col + snap->cols == game->WALL_WD) {
+      backend->put(backend, i, snap->cols-1, '*', COLOUR_WALL);
+    }
+  }
+}
+
+/*  Draw the queued direction of the snake. */
+void draw_direction (Direction queued_dir, struct backend *backend)
+{
+    char c;
+    switch (queued_dir) {
+      case NORTH:
+        c = 'N';
+        break;
+      case SOUTH:
+        c = 'S';
+        break;
+      case WEST:
+        c = 'W';
+        break;
+      case EAST:
+        c = 'E';
+        break;
+    }
+    backend->put(backend, 2, hud_col, c, COLOUR_PLAIN);
+}
+
+/*  Draw a labelled statistic in the column beside the board. */
+void draw_stat (int row, char *label, long int value, struct backend *backend)
+{
+  char text[64];
+  snprintf(text, sizeof text, "%s: %ld", label, value);
+  backend->print(backend, row, hud_col, text);
+}
+
+/*  Draw whatever is on one cell of the board inside the walls in a
+    snapshot, if it's in view: part of the snake, the food or nothing. */
+void draw_cell (struct point p, struct snapshot *snap, struct backend *backend)
+{
+  if (!in_view(snap, p)) return;
+  int row = p.row - snap->origin.row, col = p.col - snap->origin.col;
+  struct point food = snap->food;
+  if (snap->cells[row * snap->cols + col]) {
+    backend->put(backend, row, col, '*', COLOUR_SNAKE);
+  }
+  else if (p.row == food.row && p.col == food.col) draw_food(snap, backend);
+  else backend->put(backend, row, col, ' ', COLOUR_PLAIN);
+}
+
+/*  Remember that a cell has changed and needs to be drawn next frame. */
+void mark_damage (struct damage *damage, struct point p)
+{
+  if (damage->num_cells == MAX_DAMAGE) damage->full = 1;
+  else damage->cells[damage->num_cells++] = p;
+}
+
+/*  Mark the cells which differ between the snapshot last drawn and a new
+    one, then copy the new one over the one drawn. If the view has moved,
+    everything in it has. */
+void mark_changes (struct damage *damage, struct snapshot *drawn, struct snapshot *snap)
+{
+  if (drawn->origin.row != snap->origin.row || drawn->origin.col != snap->origin.col) {
+    damage->full = 1;
+  }
+  int c, cells = snap->rows * snap->cols;
+  for (c=0; c<cells && !damage->full; c++) {
+    if (drawn->cells[c] == snap->cells[c]) continue;
+    struct point p = { snap->origin.row + c / snap->cols, snap->origin.col + c % snap->cols };
+    mark_damage(damage, p);
+  }
+  if (drawn->food.row != snap->food.row || drawn->food.col != snap->food.col) {
+    mark_damage(damage, drawn->food);
+    mark_damage(damage, snap->food);
+  }
+  copy_snapshot(drawn, snap);
+}
+
+/*  Draw the cells of a snapshot which have changed since the last frame,
+    or the whole view if that has been asked for, then forget about them.
+    Once the snake fills the board there is no food left to draw. */
+void draw_damage (struct damage *damage, struct game_data *game,
+                  struct snapshot *snap, struct backend *backend)
+{
+  if (damage->full) {
+    backend->blank(backend);
+    draw_snake(snap, backend);
+    if (snap->outcome != WON) draw_food(snap, backend);
+    draw_wall(game, snap, backend);
+  }
+  else {
+    int i;
+    for (i=0; i<damage->num_cells; i++) {
+      draw_cell(damage->cells[i], snap, backend);
+    }
+  }
+  damage->num_cells = 0;
+  damage->full = 0;
+}
+
+/*  Draw a minimap in the HUD, if there is one, each cell as a character
+    which looks fuller the more of its block of the board the snake is on.
+    The cell with the snake's head in it is highlighted. */
+void draw_minimap (struct minimap *map, struct backend *backend)
+{
+  static char shades[MINIMAP_LEVELS] = { '.', ':', '-', '=', '+', '*', '#', '%', '@' };
+  int row, col;
+  for (row=0; row<map->rows; row++) {
+    for (col=0; col<map->cols; col++) {
+      int head = row == map->head_row && col == map->head_col;
+      backend->put(backend, MINIMAP_ROW + row, hud_col + col,
+                   shades[map->level[row * map->cols + col]],
+                   head ? COLOUR_HIGHLIGHT : COLOUR_PLAIN);
+    }
+  }
+}
+
+/*  Draw the latency of each phase of a tick, in microseconds, in the
+    column beside the board starting at the given row. */
+void draw_metrics (int row, struct backend *backend)
+{
+  char text[64];
+  snprintf(text, sizeof text, "%-8s %8s %8s %8s", "us", "p50", "p99", "max");
+  backend->print(backend, row, hud_col, text);
+  Phase p;
+  for (p=0; p<NUM_PHASES; p++) {
+    struct histogram *hist = &metrics.phases[p];
+    snprintf(text, sizeof text, "%-8s %8.1f %8.1f %8.1f", phase_name(p),
+             hist_percentile(hist, 50) / 1e3, hist_percentile(hist, 99) / 1e3,
+             hist_read(&hist->max) / 1e3);
+    backend->print(backend, row + 1 + p, hud_col, text);
+  }
+}
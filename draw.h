@@ -0,0 +1,63 @@
+#ifndef DRAW_H
+#define DRAW_H
+
+#include "game.h"
+#include "render.h"
+#include "snapshot.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// cells which can change between frames: head, tail and food for each
+// step, with room for the twenty or so steps a fast simulation makes
+// between frames
+#define MAX_DAMAGE 64
+
+// the column the HUD beside the board starts at, unless the board's view
+// is wider; the columns between them then, and the columns the HUD takes
+#define HUD_MIN_COL 45
+#define HUD_MARGIN 2
+#define HUD_WIDTH 40
+
+// where the minimap goes in the HUD, below the stats, and where the
+// latency metrics go if there's no minimap for them to go below
+#define MINIMAP_ROW 15
+#define METRICS_ROW 14
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// Cells of the board which have changed since the last frame. If there
+// are too many to list, or the whole window needs repainting (e.g. after
+// the terminal is resized), full is set instead.
+struct damage {
+  struct point cells[MAX_DAMAGE];
+  int num_cells;
+  int full;
+};
+
+// ------------------------------------------------------------
+// Globals.
+// ------------------------------------------------------------
+
+extern int hud_col;
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+void draw_snake (struct snapshot *, struct backend *);
+void draw_wall (struct game_data *, struct snapshot *, struct backend *);
+void draw_food (struct snapshot *, struct backend *);
+void draw_direction (Direction, struct backend *);
+void draw_stat (int row, char *label, long int value, struct backend *);
+void draw_cell (struct point, struct snapshot *, struct backend *);
+void draw_damage (struct damage *, struct game_data *, struct snapshot *, struct backend *);
+void mark_damage (struct damage *, struct point);
+void mark_changes (struct damage *, struct snapshot *drawn, struct snapshot *snap);
+void draw_metrics (int row, struct backend *);
+void draw_minimap (struct minimap *, struct backend *);
+
+#endif
@@ -0,0 +1,210 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "render.h"
+
+
+
+// ------------------------------------------------------------
+// Null backend.
+// ------------------------------------------------------------
+
+static void
+null_put (struct backend *backend, int row, int col, char c, Colour colour)
+{
+  struct null_counts *counts = backend->data;
+  counts->cells++;
+}
+
+static void
+null_print (struct backend *backend, int row, int col, char *text)
+{
+  struct null_counts *counts = backend->data;
+  counts->cells += strlen(text);
+}
+
+static void
+null_blank (struct backend *backend)
+{
+}
+
+static void
+null_resize (struct backend *backend, int rows, int cols)
+{
+}
+
+static int
+null_present (struct backend *backend)
+{
+  struct null_counts *counts = backend->data;
+  counts->frames++;
+  return 1;
+}
+
+static void
+null_close (struct backend *backend)
+{
+}
+
+/*  Set up a backend which draws nothing, and only counts the cells it is
+    asked to draw and the frames it is asked to present, so that what is
+    measured is the cost of deciding what to draw. */
+void
+init_null_backend (struct backend *backend, struct null_counts *counts)
+{
+  backend->name = "null";
+  backend->put = null_put;
+  backend->print = null_print;
+  backend->blank = null_blank;
+  backend->resize = null_resize;
+  backend->present = null_present;
+  backend->close = null_close;
+  backend->data = counts;
+  backend->bytes = 0;
+  counts->cells = 0;
+  counts->frames = 0;
+}
+
+
+
+// ------------------------------------------------------------
+// Frame buffer backend.
+// ------------------------------------------------------------
+
+/*  Get where a cell's character is kept in a frame buffer. Its colour is
+    kept rows lines further on. */
+static char *
+frame_at (struct frame_buffer *frame, int row, int col)
+{
+  return &frame->text[(size_t) row * (frame->cols + 1) + col];
+}
+
+static void
+frame_put (struct backend *backend, int row, int col, char c, Colour colour)
+{
+  struct frame_buffer *frame = backend->data;
+  if (row < 0 || row >= frame->rows || col < 0 || col >= frame->cols) return;
+  *frame_at(frame, row, col) = c;
+  *frame_at(frame, frame->rows + row, col) = '0' + colour;
+}
+
+/*  Write text in the plain colour, and blank the rest of the row. */
+static void
+frame_print (struct backend *backend, int row, int col, char *text)
+{
+  struct frame_buffer *frame = backend->data;
+  if (row < 0 || row >= frame->rows) return;
+  for (; col < frame->cols; col++) {
+    frame_put(backend, row, col, *text == '\0' ? ' ' : *text, COLOUR_PLAIN);
+    if (*text != '\0') text++;
+  }
+}
+
+static void
+frame_blank (struct backend *backend)
+{
+  struct frame_buffer *frame = backend->data;
+  int row;
+  for (row=0; row<frame->rows; row++) {
+    memset(frame_at(frame, row, 0), ' ', frame->cols);
+    *frame_at(frame, row, frame->cols) = '\n';
+    memset(frame_at(frame, frame->rows + row, 0), '0' + COLOUR_PLAIN, frame->cols);
+    *frame_at(frame, frame->rows + row, frame->cols) = '\n';
+  }
+}
+
+/*  Frames are drawn straight into the buffer, so there is nothing to send.
+    A mapped file is written back by the kernel when it gets round to it,
+    or when the buffer is closed. */
+static int
+frame_present (struct backend *backend)
+{
+  struct frame_buffer *frame = backend->data;
+  frame->frames++;
+  return 1;
+}
+
+static void
+free_text (struct frame_buffer *frame)
+{
+  if (frame->text == NULL) return;
+  if (frame->path != NULL) munmap(frame->text, frame->size);
+  else free(frame->text);
+  frame->text = NULL;
+}
+
+static void
+frame_close (struct backend *backend)
+{
+  free_text(backend->data);
+}
+
+/*  Make the buffer for a frame of the given size, in memory or mapped
+    from the frame's file, which is cut to fit. Returns zero if it
+    couldn't be made, leaving a frame with no cells. */
+static int
+make_text (struct frame_buffer *frame, int rows, int cols)
+{
+  frame->rows = 0;
+  frame->cols = 0;
+  frame->size = (size_t) 2 * rows * (cols + 1);
+
+  if (frame->path == NULL) frame->text = malloc(frame->size);
+  else {
+    int fd = open(frame->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 0;
+    void *text = MAP_FAILED;
+    if (ftruncate(fd, frame->size) == 0) {
+      text = mmap(NULL, frame->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    frame->text = text == MAP_FAILED ? NULL : text;
+  }
+  if (frame->text == NULL) return 0;
+
+  frame->rows = rows;
+  frame->cols = cols;
+  return 1;
+}
+
+static void
+frame_resize (struct backend *backend, int rows, int cols)
+{
+  struct frame_buffer *frame = backend->data;
+  free_text(frame);
+  make_text(frame, rows, cols);
+  frame_blank(backend);
+}
+
+/*  Set up a backend which draws frames of the given size into a buffer of
+    text. If path is given the buffer is that file mapped into memory, so
+    the last frame drawn is left in the file; otherwise it lives on the
+    heap. Returns zero if the buffer couldn't be made. */
+int
+init_frame_backend (struct backend *backend, struct frame_buffer *frame,
+                    char *path, int rows, int cols)
+{
+  backend->name = "frame";
+  backend->put = frame_put;
+  backend->print = frame_print;
+  backend->blank = frame_blank;
+  backend->resize = frame_resize;
+  backend->present = frame_present;
+  backend->close = frame_close;
+  backend->data = frame;
+  backend->bytes = 0;
+
+  frame->path = path;
+  frame->text = NULL;
+  frame->frames = 0;
+  if (!make_text(frame, rows, cols)) return 0;
+  frame_blank(backend);
+  return 1;
+}
@@ -0,0 +1,487 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <string.h>
+
+#include "game.h"
+#include "metrics.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+#define MAX(X,Y) X>Y?X:Y
+#define MIN(X,Y) X<Y?X:Y
+
+// initial number of segments the snake has room for
+#define SNAKE_MIN_CAPACITY 16
+
+// most cells a board can have for its free cells to be kept as a set;
+// bigger boards place food by picking cells at random until one is free
+#define MAX_FREE_SET_CELLS (2048 * 2048)
+
+// how many cells are picked at random on a big board before giving up
+// and searching for a free one
+#define FOOD_TRIES 64
+
+// how far from the head, in rows and columns, food is put on an
+// unbounded board
+#define FOOD_RANGE 16
+
+
+
+// ------------------------------------------------------------
+// Time functions.
+// ------------------------------------------------------------
+
+/*  Get the amount of time to wait between steps of the game world. This should
+    increase with difficulty. */
+long int update_delay (struct game_data *game) {
+  long int delay = 300 - 20*game->difficulty;
+  if (delay < 20) return 20;
+  return delay;
+}
+
+
+
+// ------------------------------------------------------------
+// Snake functions.
+// ------------------------------------------------------------
+
+/*  Get the index of a point in the snake's occupancy grid. */
+static inline int
+cell (struct snake *snake, struct point p)
+{
+  return p.row * snake->board_wd + p.col;
+}
+
+/*  Get the word of the snake's bit-packed board holding a point. */
+static inline uint64_t *
+bit_word (struct snake *snake, struct point p)
+{
+  return &snake->bits[(size_t) p.row * snake->words_per_row + p.col / 64];
+}
+
+/*  Add a segment to a cell of the occupancy grid, taking the cell out of
+    the free set if it was empty. */
+static inline void
+occupy (struct snake *snake, struct point p)
+{
+  if (snake->chunks != NULL) {
+    chunk_add(snake->chunks, p.row, p.col);
+    return;
+  }
+  int c = cell(snake, p);
+  if (snake->occupied[c]++ != 0) return;
+  *bit_word(snake, p) |= (uint64_t) 1 << (p.col % 64);
+  if (snake->free_cells == NULL) {
+    snake->num_free--;
+    return;
+  }
+  int pos = snake->free_pos[c];
+  int last = snake->free_cells[--snake->num_free];
+  snake->free_cells[pos] = last;
+  snake->free_pos[last] = pos;
+}
+
+/*  Remove a segment from a cell of the occupancy grid, putting the cell
+    back in the free set if it is now empty. */
+static inline void
+vacate (struct snake *snake, struct point p)
+{
+  if (snake->chunks != NULL) {
+    chunk_remove(snake->chunks, p.row, p.col);
+    return;
+  }
+  int c = cell(snake, p);
+  if (--snake->occupied[c] != 0) return;
+  *bit_word(snake, p) &= ~((uint64_t) 1 << (p.col % 64));
+  if (snake->free_cells == NULL) {
+    snake->num_free++;
+    return;
+  }
+  snake->free_pos[c] = snake->num_free;
+  snake->free_cells[snake->num_free++] = c;
+}
+
+/*  Create a snake with a single segment at the specified (row,col)
+    position, on a board the size of the game's walls. Its memory is
+    allocated from the arena. */
+struct snake *init_snake (struct arena *arena, struct game_data *game, int row, int col)
+{
+  struct snake *snake = arena_alloc(arena, sizeof (struct snake));
+  snake->arena = arena;
+  snake->body = arena_alloc(arena, SNAKE_MIN_CAPACITY * sizeof (struct point));
+  snake->capacity = SNAKE_MIN_CAPACITY;
+  snake->head = 0;
+  snake->length = 1;
+  snake->body[0].row = row;
+  snake->body[0].col = col;
+
+  // An unbounded board only keeps the chunks the snake is on.
+  snake->chunks = NULL;
+  if (game->unbounded) {
+    snake->chunks = arena_alloc(arena, sizeof (struct chunk_map));
+    init_chunk_map(snake->chunks, arena);
+    snake->occupied = NULL;
+    snake->bits = NULL;
+    snake->words_per_row = 0;
+    snake->free_cells = NULL;
+    snake->free_pos = NULL;
+    snake->num_free = 0;
+    occupy(snake, snake->body[0]);
+    return snake;
+  }
+
+  // Every cell inside the walls starts out free.
+  int cells = game->WALL_HT * game->WALL_WD;
+  snake->occupied = arena_calloc(arena, cells);
+  snake->board_wd = game->WALL_WD;
+  snake->words_per_row = (game->WALL_WD + 63) / 64;
+  snake->bits = arena_calloc(arena, (size_t) game->WALL_HT * snake->words_per_row * sizeof (uint64_t));
+  if (cells > MAX_FREE_SET_CELLS) {
+    snake->free_cells = NULL;
+    snake->free_pos = NULL;
+    snake->num_free = (game->WALL_HT-2) * (game->WALL_WD-2);
+    occupy(snake, snake->body[0]);
+    return snake;
+  }
+  snake->free_cells = arena_alloc(arena, (game->WALL_HT-2) * (game->WALL_WD-2) * sizeof (int));
+  snake->free_pos = arena_alloc(arena, cells * sizeof (int));
+  snake->num_free = 0;
+  int r, c;
+  for (r=1; r<game->WALL_HT-1; r++) {
+    for (c=1; c<game->WALL_WD-1; c++) {
+      int i = r * game->WALL_WD + c;
+      snake->free_pos[i] = snake->num_free;
+      snake->free_cells[snake->num_free++] = i;
+    }
+  }
+
+  occupy(snake, snake->body[0]);
+  return snake;
+}
+
+/*  Get the position of the head of the snake. */
+struct point snake_head (struct snake *snake)
+{
+  return snake->body[snake->head];
+}
+
+/*  Get the position of the i'th segment of the snake, where the head is
+    segment zero and the tail is segment length-1. */
+struct point snake_segment (struct snake *snake, int i)
+{
+  return snake->body[(snake->head + i) & (snake->capacity - 1)];
+}
+
+/*  Double the capacity of the snake's ring buffer, unwrapping it so the
+    head ends up at index zero. The old buffer stays in the arena until the
+    game is over, which at most doubles the memory used by the body. */
+static void
+expand_snake (struct snake *snake)
+{
+  int capacity = snake->capacity * 2;
+  struct point *body = arena_alloc(snake->arena, capacity * sizeof (struct point));
+
+  // Copy the run from the head to the end of the buffer, then the run
+  // which wrapped around to the start.
+  int first = snake->capacity - snake->head;
+  if (first > snake->length) first = snake->length;
+  memcpy(body, snake->body + snake->head, first * sizeof (struct point));
+  memcpy(body + first, snake->body, (snake->length - first) * sizeof (struct point));
+
+  snake->body = body;
+  snake->capacity = capacity;
+  snake->head = 0;
+}
+
+/*  Check to see if the body of the snake is touching the specified
+    row and col. */
+int touching (struct snake *snake, struct point *p)
+{
+  if (snake->chunks != NULL) return chunk_count(snake->chunks, p->row, p->col) != 0;
+  return snake->occupied[cell(snake, *p)] != 0;
+}
+
+/*  Check to see if the head of the snake is touching the rest of its
+    body. */
+int bitten (struct snake *snake)
+{
+  struct point head = snake_head(snake);
+  if (snake->chunks != NULL) return chunk_count(snake->chunks, head.row, head.col) > 1;
+  return snake->occupied[cell(snake, head)] > 1;
+}
+
+/*  Copy which cells of a rows by cols window of the board, with its top
+    left at origin, have part of the snake on them into out, one byte a
+    cell. The window must be inside the walls of a bounded board. */
+void
+read_cells (struct snake *snake, struct point origin, int rows, int cols,
+            unsigned char *out)
+{
+  if (snake->chunks != NULL) {
+    chunk_window(snake->chunks, origin.row, origin.col, rows, cols, out);
+    return;
+  }
+  int row;
+  for (row=0; row<rows; row++) {
+    unsigned char *from = &snake->occupied[cell(snake, origin) + row * snake->board_wd];
+    memcpy(&out[row * cols], from, cols);
+  }
+}
+
+/*  Prepend a new head to the snake without removing its tail. */
+void
+grow_snake (struct game_data *game, struct snake *snake, struct point newpos)
+{
+  if (snake->length == snake->capacity) expand_snake(snake);
+  snake->head = (snake->head - 1) & (snake->capacity - 1);
+  snake->body[snake->head] = newpos;
+  snake->length++;
+  occupy(snake, newpos);
+}
+
+/*  Move the snake one step to the specified position. The tail is dropped
+    and the new position becomes the head, so no other segment is touched. */
+void
+move_snake (struct game_data *game, struct snake *snake, struct point newpos) {
+  struct point tail = snake_segment(snake, snake->length - 1);
+  vacate(snake, tail);
+  snake->head = (snake->head - 1) & (snake->capacity - 1);
+  snake->body[snake->head] = newpos;
+  occupy(snake, newpos);
+}
+
+struct point
+new_pos (struct game_data *game, struct snake *snake, Direction dir)
+{
+
+  // Figure out where the snake should now be. There are no walls to stop
+  // it on an unbounded board.
+  struct point head = snake_head(snake);
+  int newRow = head.row;
+  int newCol = head.col;
+  if (game->unbounded) {
+    switch (dir) {
+      case NORTH: newRow--; break;
+      case SOUTH: newRow++; break;
+      case WEST: newCol--; break;
+      case EAST: newCol++; break;
+    }
+    struct point p = {newRow, newCol};
+    return p;
+  }
+  switch (dir) {
+    case NORTH:
+      newRow = MAX(head.row-1, 1);
+      break;
+
+    case SOUTH:
+      newRow = MIN(head.row+1, game->WALL_HT-2);
+      break;
+
+    case WEST:
+      newCol = MAX(head.col-1, 1);
+      break;
+
+    case EAST:
+      newCol = MIN(head.col+1, game->WALL_WD-2);
+      break;
+  }
+
+  // Return as a point.
+  struct point p = {newRow, newCol};
+  return p;
+
+}
+
+int opposites (Direction d1, Direction d2)
+{
+  if (d1 == NORTH && d2 == SOUTH) return 1;
+  if (d1 == SOUTH && d2 == NORTH) return 1;
+  if (d1 == WEST && d2 == EAST) return 1;
+  if (d1 == EAST && d2 == WEST) return 1;
+  return 0;
+}
+
+
+
+// ------------------------------------------------------------
+// Random number functions.
+// ------------------------------------------------------------
+
+/*  Seed a random number generator. Nearby seeds give unrelated streams,
+    since the seed is scrambled (with splitmix64) before use. */
+void
+seed_rng (struct rng *rng, uint64_t seed)
+{
+  uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z = z ^ (z >> 31);
+
+  // xorshift gets stuck on zero.
+  rng->state = z ? z : 1;
+}
+
+/*  Get the next 32 random bits (xorshift64*). */
+uint32_t
+rng_next (struct rng *rng)
+{
+  uint64_t x = rng->state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  rng->state = x;
+  return (x * 0x2545f4914f6cdd1dULL) >> 32;
+}
+
+/*  Get a random number in [0, n). */
+int
+rng_below (struct rng *rng, int n)
+{
+  return ((uint64_t) rng_next(rng) * n) >> 32;
+}
+
+
+
+// ------------------------------------------------------------
+// Food functions.
+// ------------------------------------------------------------
+
+/*  Pick a free cell on a board too big to keep a set of them. Almost all
+    of such a board is free, so cells picked at random nearly always are;
+    if they keep not being, the board is searched from a random cell on.
+    There is at least one free cell. */
+static int
+pick_free (struct game_data *game, struct snake *snake,
+           struct rng *rng, struct point *food)
+{
+  int inner_ht = game->WALL_HT - 2, inner_wd = game->WALL_WD - 2;
+  int i;
+  for (i=0; i<FOOD_TRIES; i++) {
+    struct point p = { 1 + rng_below(rng, inner_ht), 1 + rng_below(rng, inner_wd) };
+    if (!touching(snake, &p)) {
+      *food = p;
+      return 1;
+    }
+  }
+
+  int inner = inner_ht * inner_wd;
+  int start = rng_below(rng, inner);
+  for (i=0; i<inner; i++) {
+    int k = (start + i) % inner;
+    struct point p = { 1 + k / inner_wd, 1 + k % inner_wd };
+    if (!touching(snake, &p)) {
+      *food = p;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*  Pick a free cell on an unbounded board, near enough to the head to be
+    worth going for. If the snake is coiled up around the head, cells are
+    picked further and further away until one is free, which there always
+    is. */
+static int
+pick_near (struct snake *snake, struct rng *rng, struct point *food)
+{
+  struct point head = snake_head(snake);
+  int range = FOOD_RANGE;
+  while (1) {
+    int i;
+    for (i=0; i<FOOD_TRIES; i++) {
+      struct point p = { head.row - range + rng_below(rng, 2*range + 1),
+                         head.col - range + rng_below(rng, 2*range + 1) };
+      if (!touching(snake, &p)) {
+        *food = p;
+        return 1;
+      }
+    }
+    range *= 2;
+  }
+}
+
+/*  Pick a random point within the boundaries of the game which the snake
+    is not on, and store it in food. Returns zero if the snake covers the
+    whole board so there is nowhere to put the food. Otherwise returns a
+    non-zero value. */
+int
+randomise_food (struct game_data *game, struct snake *snake,
+                struct rng *rng, struct point *food)
+{
+  if (snake->chunks != NULL) return pick_near(snake, rng, food);
+  if (snake->num_free == 0) return 0;
+  if (snake->free_cells == NULL) return pick_free(game, snake, rng, food);
+  int c = snake->free_cells[rng_below(rng, snake->num_free)];
+  food->row = c / snake->board_wd;
+  food->col = c % snake->board_wd;
+  return 1;
+}
+
+
+
+// ------------------------------------------------------------
+// Game functions.
+// ------------------------------------------------------------
+
+/*  Start a new game on the given board, allocating from the arena. The
+    snake starts in the middle heading north, and the food is placed using
+    the seeded generator. */
+void
+init_game (struct game_state *state, struct game_data *game,
+           struct arena *arena, uint64_t seed)
+{
+  state->game = game;
+  state->snake = init_snake(arena, game, game->WALL_HT/2, game->WALL_WD/2);
+  struct point start = {game->WALL_HT/2 + 1, game->WALL_WD/2};
+  grow_snake(game, state->snake, start);
+  grow_snake(game, state->snake, start);
+
+  state->dir = NORTH;
+  state->ate_food = 0;
+  state->score = 0;
+  state->ticks = 0;
+  seed_rng(&state->rng, seed);
+  randomise_food(game, state->snake, &state->rng, &state->food);
+}
+
+/*  Step the game world once, with the snake trying to head in the input
+    direction. A snake can't turn back on itself, so an input opposite to
+    its current direction is ignored. Returns whether the snake is still
+    playing, has died or has filled the board. */
+Outcome
+game_step (struct game_state *state, Direction input)
+{
+  struct game_data *game = state->game;
+  struct snake *snake = state->snake;
+
+  // Get direction. Move snake and grow in length.
+  if (!opposites(state->dir, input)) state->dir = input;
+  struct point newpos = new_pos(game, snake, state->dir);
+  if (state->ate_food) {
+    grow_snake(game, snake, newpos);
+    state->ate_food = 0;
+  }
+  else move_snake(game, snake, newpos);
+  state->ticks++;
+
+  // Snake touching itself? Game over, man!
+  if (bitten(snake)) return DIED;
+
+  // If Snake has eaten food, randomly generate new food. Nowhere left to
+  // put it? The snake fills the board.
+  if (touching(snake, &state->food)) {
+    state->score++;
+    state->ate_food = 1;
+    int64_t start = metrics_begin();
+    int placed = randomise_food(game, snake, &state->rng, &state->food);
+    metrics_end(PHASE_FOOD, start);
+    if (!placed) return WON;
+  }
+
+  return PLAYING;
+}
@@ -0,0 +1,143 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "chunk.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// fewest and most rows or columns a board can have, walls included
+#define MIN_BOARD 4
+#define MAX_BOARD 10000
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// Represents the direction of the snake.
+typedef enum {NORTH, EAST, SOUTH, WEST} Direction;
+
+// What happened to the snake in a step of the game.
+typedef enum {PLAYING, DIED, WON} Outcome;
+
+struct point {
+  int row;
+  int col;
+};
+
+// The body of the snake is a ring buffer of segments. The head is at
+// body[head] and segment i (counting back from the head) is at
+// body[(head + i) & (capacity - 1)], so moving is a push at the head and
+// a pop at the tail.
+//
+// The snake also keeps an occupancy grid of the board, holding the number
+// of segments on each cell. It is updated as the head enters a cell and
+// the tail leaves one, so collision checks are a single lookup. Alongside
+// it, bits has a bit set for each cell with a segment on it, packed into
+// words_per_row words a row, so that the board can be summed up quickly.
+//
+// Everything the snake uses comes from an arena, and is freed along with
+// it.
+//
+// The cells inside the walls which the snake is not on are kept as a set:
+// free_cells[0..num_free) lists them densely and free_pos[c] is where cell
+// c sits in that list, so a cell can be added, removed or picked at random
+// in constant time. On a large board the set would take far more memory
+// than the board itself, so free_cells and free_pos are NULL and only
+// num_free is kept up.
+//
+// An unbounded board has no grid, bits or free set. Instead chunks holds
+// how many segments are on each cell, for only the parts of the board the
+// snake is on.
+struct snake {
+  struct point *body;
+  int capacity; // Always a power of two.
+  int head;
+  int length;
+  unsigned char *occupied; // WALL_HT rows of WALL_WD cells.
+  int board_wd;
+  uint64_t *bits;
+  int words_per_row;
+  int *free_cells;
+  int *free_pos;
+  int num_free;
+  struct chunk_map *chunks;
+  struct arena *arena;
+};
+
+// rows and cols are the size of the terminal. A board bigger than the
+// terminal is seen through a view of view_ht rows of view_wd cells, which
+// follows the snake's head; zero means the whole board is seen. If
+// unbounded is set the board goes on forever with no walls, and WALL_HT
+// and WALL_WD only say where the snake starts and how big a view is by
+// default.
+struct game_data {
+  int rows;
+  int cols;
+  int WALL_HT;
+  int WALL_WD;
+  int difficulty;
+  int view_ht;
+  int view_wd;
+  int unbounded;
+};
+
+// A pseudo-random number generator. Each game has its own, so a game is
+// determined entirely by its seed and its inputs.
+struct rng {
+  uint64_t state;
+};
+
+// Everything about a game in progress. Nothing in here knows about the
+// terminal, so games can be stepped as fast as the CPU allows. The game's
+// memory belongs to the arena it was started with.
+struct game_state {
+  struct game_data *game;
+  struct snake *snake;
+  struct point food;
+  Direction dir;
+  int ate_food;
+  int score;
+  long int ticks;
+  struct rng rng;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+// Snake-related functions.
+struct snake *init_snake (struct arena *arena, struct game_data *game, int row, int col);
+struct point snake_head (struct snake *snake);
+struct point snake_segment (struct snake *snake, int i);
+struct point new_pos (struct game_data *, struct snake *, Direction dir);
+void move_snake (struct game_data *game, struct snake *snake, struct point);
+void read_cells (struct snake *snake, struct point origin, int rows, int cols,
+                 unsigned char *out);
+void grow_snake (struct game_data *game, struct snake *snake, struct point);
+int touching (struct snake *snake, struct point *p);
+int bitten (struct snake *snake);
+int opposites (Direction d1, Direction d2);
+
+// Food-related functions.
+int randomise_food (struct game_data *game, struct snake *snake,
+                    struct rng *rng, struct point *food);
+
+// Random number functions.
+void seed_rng (struct rng *rng, uint64_t seed);
+uint32_t rng_next (struct rng *rng);
+int rng_below (struct rng *rng, int n);
+
+// Game-related functions.
+void init_game (struct game_state *state, struct game_data *game,
+                struct arena *arena, uint64_t seed);
+Outcome game_step (struct game_state *state, Direction input);
+
+// Time-related functions.
+long int update_delay (struct game_data *);
+
+#endif
@@ -0,0 +1,136 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <string.h>
+
+#include "hamilton.h"
+
+
+
+// ------------------------------------------------------------
+// Cycle functions.
+// ------------------------------------------------------------
+
+/*  Get where cell (r, c) comes on the cycle through a rows by cols grid,
+    rows being even, counting from the top left corner. */
+static inline long int
+cycle_formula (long int rows, long int cols, long int r, long int c)
+{
+  if (r == 0) return c;
+  if (c == 0) return cols + (rows - 1) * (cols - 1) + (rows - 1 - r);
+  long int base = cols + (r - 1) * (cols - 1);
+  return r % 2 ? base + (cols - 1 - c) : base + (c - 1);
+}
+
+/*  Get where a cell inside the walls comes on the cycle. */
+static inline long int
+cycle_index (struct hamilton *cycle, struct point p)
+{
+  long int r = p.row - 1, c = p.col - 1;
+  if (cycle->order != NULL) return cycle->order[r * cycle->cols + c];
+  if (cycle->transposed) return cycle_formula(cycle->cols, cycle->rows, c, r);
+  return cycle_formula(cycle->rows, cycle->cols, r, c);
+}
+
+/*  Get how far along the cycle index b is from index a. */
+static inline long int
+cycle_distance (struct hamilton *cycle, long int a, long int b)
+{
+  long int d = b - a;
+  return d < 0 ? d + cycle->cells : d;
+}
+
+/*  Set up the cycle through the inside of a board, keeping it as a table
+    if the board isn't too big, in time linear in the size of the board.
+    Returns zero if the board has no cycle, which is when the inside of it
+    has an odd number of both rows and columns. */
+int
+init_hamilton (struct hamilton *cycle, struct arena *arena, struct game_data *game)
+{
+  memset(cycle, 0, sizeof *cycle);
+  cycle->rows = game->WALL_HT - 2;
+  cycle->cols = game->WALL_WD - 2;
+  if (game->unbounded || (cycle->rows % 2 && cycle->cols % 2)) return 0;
+  cycle->transposed = cycle->rows % 2;
+  cycle->cells = (long int) cycle->rows * cycle->cols;
+  if (cycle->cells > MAX_CYCLE_TABLE_CELLS) return 1;
+
+  uint32_t *order = arena_alloc(arena, cycle->cells * sizeof (uint32_t));
+  long int r, c;
+  for (r=0; r<cycle->rows; r++) {
+    uint32_t *row = order + r * cycle->cols;
+    for (c=0; c<cycle->cols; c++) {
+      row[c] = cycle->transposed ? cycle_formula(cycle->cols, cycle->rows, c, r)
+                                 : cycle_formula(cycle->rows, cycle->cols, r, c);
+    }
+  }
+  cycle->order = order;
+  return 1;
+}
+
+
+
+// ------------------------------------------------------------
+// Decision functions.
+// ------------------------------------------------------------
+
+/*  Check whether the head can move onto a cell inside the walls without
+    biting the snake: the cell is free, or it's the tail and the snake
+    isn't about to grow, so the tail moves out of the way. */
+static inline int
+can_enter (struct game_state *state, struct point p)
+{
+  struct game_data *game = state->game;
+  struct snake *snake = state->snake;
+  if (p.row < 1 || p.row >= game->WALL_HT - 1) return 0;
+  if (p.col < 1 || p.col >= game->WALL_WD - 1) return 0;
+  if (!touching(snake, &p)) return 1;
+  struct point tail = snake_segment(snake, snake->length - 1);
+  return !state->ate_food && p.row == tail.row && p.col == tail.col &&
+         snake->occupied[p.row * snake->board_wd + p.col] == 1;
+}
+
+/*  Decide which way the snake goes this step: the furthest along the cycle
+    it can safely cut to without going past the food, which is the next
+    cell on the cycle when there's no shortcut to take. A snake which isn't
+    on the cycle yet, as at the start of a game, makes the move that comes
+    soonest on it. */
+Direction
+hamilton_next (struct hamilton *cycle, struct game_state *state)
+{
+  struct snake *snake = state->snake;
+  struct point head = snake_head(snake);
+  long int h = cycle_index(cycle, head);
+  long int toTail = cycle_distance(cycle, h, cycle_index(cycle, snake_segment(snake, snake->length - 1)));
+  long int toFood = cycle_distance(cycle, h, cycle_index(cycle, state->food));
+  if (toTail == 0) toTail = cycle->cells;
+
+  // How far ahead the snake may go: a cell, unless the food is ahead of
+  // the tail and there's room to cut across to it.
+  long int limit = 1;
+  if ((long int) snake->length * 100 < cycle->cells * SHORTCUT_FILL && toFood < toTail) {
+    long int room = toTail - 1 - snake->length - SHORTCUT_MARGIN;
+    limit = toFood < room ? toFood : room;
+    if (limit < 1) limit = 1;
+  }
+
+  Direction best = state->dir, nearest = state->dir;
+  long int bestAhead = 0, nearestAhead = cycle->cells;
+  Direction d;
+  for (d=NORTH; d<=WEST; d++) {
+    if (opposites(state->dir, d)) continue;
+    struct point p = new_pos(state->game, snake, d);
+    if ((p.row == head.row && p.col == head.col) || !can_enter(state, p)) continue;
+    long int ahead = cycle_distance(cycle, h, cycle_index(cycle, p));
+    if (ahead <= limit && ahead < toTail && ahead > bestAhead) {
+      best = d;
+      bestAhead = ahead;
+    }
+    if (ahead < nearestAhead) {
+      nearest = d;
+      nearestAhead = ahead;
+    }
+  }
+  return bestAhead > 0 ? best : nearest;
+}
@@ -0,0 +1,60 @@
+#ifndef HAMILTON_H
+#define HAMILTON_H
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "game.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// most cells a board can have for its cycle to be kept as a table; past
+// this the table would take far more memory than the board itself
+#define MAX_CYCLE_TABLE_CELLS (2048 * 2048)
+
+// percent of the board the snake can take up and still cut across the
+// cycle, and how many cells more than the snake is long it must leave
+// free ahead of itself when it does
+#define SHORTCUT_FILL 50
+#define SHORTCUT_MARGIN 3
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// A Hamiltonian cycle through every cell inside the walls of a board,
+// which the snake can follow to fill the board completely. There is one
+// whenever the inside of the board has an even number of rows or of
+// columns. With rows even it runs east along the top row, snakes back and
+// forth along the rows below it leaving out the first column, and comes
+// back up the first column; with only columns even it's the same turned
+// on its side.
+//
+// Where a cell comes on the cycle is worked out from its row and column
+// with a little arithmetic, and on all but the biggest boards kept in
+// order, indexed by rows * cols cells inside the walls, so that deciding
+// a move takes a handful of lookups.
+//
+// The snake keeps its body on the stretch of the cycle from its tail to
+// its head, so everything ahead of it up to the tail is free. While the
+// snake takes up less than SHORTCUT_FILL percent of the board and the food
+// is ahead of it before the tail, it may cut across to a cell further on,
+// as long as that leaves more free cells ahead than the snake is long.
+struct hamilton {
+  int rows;
+  int cols;
+  int transposed;
+  long int cells;
+  uint32_t *order;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+int init_hamilton (struct hamilton *cycle, struct arena *arena, struct game_data *game);
+Direction hamilton_next (struct hamilton *cycle, struct game_state *state);
+
+#endif
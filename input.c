@@ -0,0 +1,179 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "input.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// bytes which start and introduce escape sequences
+#define BYTE_ESC 0x1b
+#define BYTE_CSI '['
+#define BYTE_SS3 'O'
+
+
+
+// ------------------------------------------------------------
+// Decoding functions.
+// ------------------------------------------------------------
+
+/*  Get the time on the monotonic clock in nanoseconds. */
+int64_t
+timens (void)
+{
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return (int64_t) tp.tv_sec * 1000000000 + tp.tv_nsec;
+}
+
+void
+init_decoder (struct input_decoder *decoder)
+{
+  decoder->state = DECODE_GROUND;
+}
+
+/*  Add an event to the list, unless it's full. */
+static void
+emit (InputKey key, int64_t time, struct input_event *events, int *num_events,
+      int max_events)
+{
+  if (*num_events == max_events) return;
+  events[*num_events].key = key;
+  events[*num_events].time = time;
+  (*num_events)++;
+}
+
+/*  Feed one byte to the decoder. */
+static void
+decode (struct input_decoder *decoder, unsigned char c, int64_t time,
+        struct input_event *events, int *num_events, int max_events)
+{
+  switch (decoder->state) {
+
+    case DECODE_GROUND:
+      if (c == BYTE_ESC) decoder->state = DECODE_ESC;
+      break;
+
+    // An escape which isn't followed by [ or O was the escape key on its
+    // own, or alt held with another key; either way it quits.
+    case DECODE_ESC:
+      if (c == BYTE_CSI || c == BYTE_SS3) {
+        decoder->state = DECODE_SEQ;
+        break;
+      }
+      emit(INPUT_ESC, time, events, num_events, max_events);
+      decoder->state = DECODE_GROUND;
+      decode(decoder, c, time, events, num_events, max_events);
+      break;
+
+    // Skip parameters and intermediates up to the final byte, which says
+    // what the sequence was.
+    case DECODE_SEQ:
+      if (c >= 0x20 && c <= 0x3f) break;
+      decoder->state = DECODE_GROUND;
+      if (c == 'A') emit(INPUT_UP, time, events, num_events, max_events);
+      else if (c == 'B') emit(INPUT_DOWN, time, events, num_events, max_events);
+      else if (c == 'C') emit(INPUT_RIGHT, time, events, num_events, max_events);
+      else if (c == 'D') emit(INPUT_LEFT, time, events, num_events, max_events);
+      else if (c == BYTE_ESC) decoder->state = DECODE_ESC;
+      break;
+
+  }
+}
+
+/*  Read every byte waiting on fd, without blocking, and decode it into
+    events stamped with the time they were read. Returns the number of
+    events, at most max_events.
+
+    A terminal writes a whole escape sequence at once, so an escape which
+    is the last byte waiting is taken to be the escape key straight away,
+    rather than waiting to see if more follows the way ncurses does.
+
+    fd is never made non-blocking, since on a terminal it shares its file
+    description with the output; instead only as many bytes as FIONREAD
+    says are waiting are read. */
+int
+read_input (struct input_decoder *decoder, int fd, struct input_event *events,
+            int max_events)
+{
+  int num_events = 0;
+  unsigned char buf[256];
+  int waiting;
+  while (ioctl(fd, FIONREAD, &waiting) == 0 && waiting > 0) {
+    ssize_t n = read(fd, buf, waiting < (int) sizeof buf ? waiting : (int) sizeof buf);
+    if (n <= 0) break;
+    int64_t time = timens();
+    ssize_t i;
+    for (i=0; i<n; i++) decode(decoder, buf[i], time, events, &num_events, max_events);
+  }
+
+  if (decoder->state == DECODE_ESC) {
+    emit(INPUT_ESC, timens(), events, &num_events, max_events);
+    decoder->state = DECODE_GROUND;
+  }
+  return num_events;
+}
+
+
+
+// ------------------------------------------------------------
+// Turn queue functions.
+// ------------------------------------------------------------
+
+/*  Set up an empty queue holding at most depth turns, for a snake going
+    in direction dir. */
+void
+init_turns (struct turn_queue *queue, int depth, Direction dir)
+{
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+  if (depth < 1) depth = 1;
+  if (depth > TURN_QUEUE_SIZE) depth = TURN_QUEUE_SIZE;
+  queue->depth = depth;
+  queue->last = dir;
+  queue->dropped = 0;
+  queue->overflows = 0;
+}
+
+/*  Queue a turn, read at time. Returns zero if it was dropped. */
+int
+push_turn (struct turn_queue *queue, Direction dir, int64_t time)
+{
+  if (dir == queue->last || opposites(queue->last, dir)) {
+    queue->dropped++;
+    return 0;
+  }
+
+  unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  unsigned int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+  if (tail - head >= queue->depth) {
+    queue->dropped++;
+    queue->overflows++;
+    return 0;
+  }
+
+  struct turn *turn = &queue->turns[tail & (TURN_QUEUE_SIZE - 1)];
+  turn->dir = dir;
+  turn->time = time;
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+  queue->last = dir;
+  return 1;
+}
+
+/*  Take the oldest turn off the queue. Returns zero if there wasn't one. */
+int
+pop_turn (struct turn_queue *queue, struct turn *turn)
+{
+  unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+  if (head == tail) return 0;
+  *turn = queue->turns[head & (TURN_QUEUE_SIZE - 1)];
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+  return 1;
+}
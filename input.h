@@ -0,0 +1,83 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "game.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// most events read_input hands back from one call
+#define MAX_INPUT_EVENTS 64
+
+// room in a turn queue, which must be a power of two, and how many turns
+// it holds unless told otherwise
+#define TURN_QUEUE_SIZE 16
+#define DEFAULT_TURN_DEPTH 3
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// Keys the game cares about. Anything else is thrown away.
+typedef enum { INPUT_UP, INPUT_DOWN, INPUT_LEFT, INPUT_RIGHT, INPUT_ESC } InputKey;
+
+// A key, and the time on the monotonic clock in nanoseconds when it was
+// read from the terminal.
+struct input_event {
+  InputKey key;
+  int64_t time;
+};
+
+// Where the decoder is in an escape sequence. Arrow keys arrive as
+// ESC [ A or, with the keypad in application mode, ESC O A; in between
+// there may be numeric parameters such as the 1;5 in ESC [ 1 ; 5 A.
+typedef enum { DECODE_GROUND, DECODE_ESC, DECODE_SEQ } DecodeState;
+
+// Turns the bytes read from the terminal into keys. The state carries
+// over between calls, so a sequence split across reads still decodes.
+struct input_decoder {
+  DecodeState state;
+};
+
+// A turn the player asked for, and when the key was read.
+struct turn {
+  Direction dir;
+  int64_t time;
+};
+
+// Turns waiting to be made, one per step, so that two quick turns between
+// steps both happen. Only one thread pushes and only one pops, so the
+// queue needs no lock: each side owns one index and publishes it with a
+// release store once the slot is written or read.
+//
+// A turn back the way the snake will be going by then, or the way it will
+// already be going, is dropped; so is a turn which finds the queue full,
+// which is also counted as an overflow. depth can be set lower than the
+// room in the queue, trading turns remembered for how stale they get.
+struct turn_queue {
+  _Alignas(64) _Atomic unsigned int head;
+  _Alignas(64) _Atomic unsigned int tail;
+  struct turn turns[TURN_QUEUE_SIZE];
+  unsigned int depth;
+  Direction last;
+  long int dropped;
+  long int overflows;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+int64_t timens (void);
+void init_decoder (struct input_decoder *decoder);
+int read_input (struct input_decoder *decoder, int fd,
+                struct input_event *events, int max_events);
+void init_turns (struct turn_queue *queue, int depth, Direction dir);
+int push_turn (struct turn_queue *queue, Direction dir, int64_t time);
+int pop_turn (struct turn_queue *queue, struct turn *turn);
+
+#endif
@@ -9,31 +9,24 @@
 #define KEY_ESC 27
 #define KEY_NL 10
 
-#define COLOR_NORMAL COLOR_PAIR(10)
-#define COLOR_HIGHLIGHT COLOR_PAIR(11)
-#define COLOR_SLIDER COLOR_PAIR(12)
 
   /*
     Make a text item.
     elem:
-      A struct ptr which will be used to store the item (your responsiblity
-      to free).
+      A struct ptr which will be used to store the item. Nothing else is
+      allocated, so the item can live on the stack.
     text:
-      The text that this item should display. It will be copied into the
-      struct.
+      The text that this item should display. It is not copied, so it
+      must live as long as the item.
   */
 void
 make_item_text (struct menu_item *elem, char *text)
 {
   
-  // Make the item_text struct.
-  struct item_text *item_text = malloc(sizeof (struct item_text));
-  item_text->text = text;
-  item_text->exit = 0;
-  
   // Make the elem tagged union.
   elem->tag = TEXT;
-  elem->item.text = item_text;
+  elem->item.text.text = text;
+  elem->item.text.exit = 0;
   
 }
 
@@ -42,28 +35,28 @@ make_item_text (struct menu_item *elem, char *text)
     engaged by the user it ends the menu session.
     
     elem:
-      A struct ptr which will be used to store the item (your responsiblity
-      to free).
+      A struct ptr which will be used to store the item. Nothing else is
+      allocated, so the item can live on the stack.
     text:
-      The text that this item should display. It will be copied into the
-      struct.
+      The text that this item should display. It is not copied, so it
+      must live as long as the item.
   */
 void
 make_item_exit (struct menu_item *elem, char *text)
 {
    make_item_text(elem, text);
-   elem->item.text->exit = 1;
+   elem->item.text.exit = 1;
 }
 
   /*
     Make a slider item.
 
     elem:
-      A struct ptr which will be used to store the item (your responsiblity
-      to free).
+      A struct ptr which will be used to store the item. Nothing else is
+      allocated, so the item can live on the stack.
     text:
-      The text that this item should display. It will be copied into the
-      struct, so you don't have to worry about freeing it.
+      The text that this item should display. It is not copied, so it
+      must live as long as the item.
     length:
       How long the slider is. This should be a positive number.
   */
@@ -71,21 +64,11 @@ void
 make_item_slider (struct menu_item *elem, char *text, int length)
 {
   
-  // Copy the string and allocate a new one for internal use.
-  int len = strlen(text);
-  char *copy = malloc (len + 1);
-  strcpy(copy, text);
-  copy[len] = '\0';
-  
-  // Make the item_slider struct.
-  struct item_slider *item_slider = malloc(sizeof (struct item_slider));
-  item_slider->text = copy;
-  item_slider->length = length;
-  item_slider->pos = 0;
-  
   // Make the elem tagged union.
   elem->tag = SLIDER;
-  elem->item.slider = item_slider;
+  elem->item.slider.text = text;
+  elem->item.slider.length = length;
+  elem->item.slider.pos = 0;
 
 };
 
@@ -93,10 +76,10 @@ make_item_slider (struct menu_item *elem, char *text, int length)
     Make a menu.
 
     menu:
-      A struct ptr which will be used to store the menu (your
-      responsiblity to free).
-    window:
-      The ncurses window that the menu is apart of.
+      A struct ptr which will be used to store the menu. Nothing else is
+      allocated, so the menu can live on the stack.
+    backend:
+      What the menu is drawn on.
     items:
       Array of pointers to item structs which are apart of your menu.
     num_items:
@@ -104,12 +87,12 @@ make_item_slider (struct menu_item *elem, char *text, int length)
       
   */
 void
-make_menu (struct menu *menu, WINDOW *window, struct menu_item **items, int num_items)
+make_menu (struct menu *menu, struct backend *backend, struct menu_item **items, int num_items)
 {
   
   // Make the menu struct.
   menu->indent_size = 5;
-  menu->window = window;
+  menu->backend = backend;
   
   menu->items = items;
   menu->num_items = num_items;
@@ -118,30 +101,6 @@ make_menu (struct menu *menu, WINDOW *window, struct menu_item **items, int num_
   
 }
 
-void
-free_elem (struct menu_item *elem)
-{
-  switch (elem -> tag) {
-    case SLIDER:
-      free((elem->item).slider);
-      break;
-    case TEXT:
-      free((elem->item).text);
-      break; 
-  }
-  free(elem);
-}
-  
-void
-free_menu (struct menu *menu)
-{
-  int i = 0;
-  for (; i < menu->num_items; i++) {
-    free_elem(menu->items[i]);
-  }
-  free(menu);
-}
-
   /*
     Get the EVENT_TYPE for an EVENT which fired.
     event:
@@ -172,11 +131,11 @@ slider_value (struct menu_item *item)
     fprintf(stderr, "Trying to get slider value from something which isn't a slider.");
     exit(1);
   }
-  return (item->item).slider->pos;
+  return (item->item).slider.pos;
 }
 
   /*
-    Refresh the menu by drawing its contents onto its window.
+    Refresh the menu by drawing its contents onto its backend.
 
     menu:
       To menu to refresh.
@@ -185,8 +144,9 @@ void
 menu_refresh (struct menu *menu)
 {
   
-  // Clear window.
-  wclear(menu->window);
+  // Clear the frame.
+  struct backend *backend = menu->backend;
+  backend->blank(backend);
   
   // Offsets for displaying.
   int top_offset = 1;
@@ -195,21 +155,18 @@ menu_refresh (struct menu *menu)
   // Variables for use inside switch statement.
   struct item_text *item_text;
   struct item_slider *item_slider;
+  Colour colour;
   
   // Get the menu elements.
-  WINDOW *window = menu->window;
   struct menu_item **elems = menu->items;
   int sz = menu->num_items;
   
-  // Go through each menu element, output to window.
+  // Go through each menu element, draw it.
   int i;
   
   // Whether the menu is engaged on an element.
   int engaged = menu->engaged;
   
-  // Set color.
-  attron(COLOR_NORMAL);
-  
   // Draw each item on the screen.
   for (i=0; i != sz; i++) {
     struct menu_item *elem = elems[i];
@@ -219,37 +176,37 @@ menu_refresh (struct menu *menu)
       
         case TEXT:
 	  
+	        colour = COLOUR_PLAIN;
 	        if (i == menu->selection) {
-	          wattron(window, COLOR_HIGHLIGHT);
-	          mvwprintw(window, top_offset, left_offset-3, "-->");
+	          colour = COLOUR_HIGHLIGHT;
+	          put_text(backend, top_offset, left_offset-3, "-->", colour);
 	          left_offset = left_offset + 1;
 	        }
 
-	        item_text = elem->item.text;
-          mvwprintw(window, top_offset, left_offset, item_text->text);
+	        item_text = &elem->item.text;
+          put_text(backend, top_offset, left_offset, item_text->text, colour);
           
 	        if (i == menu->selection) {
-	          wattron(window, COLOR_NORMAL);
 	          left_offset = left_offset - 1;
 	          }
      
 	        break;
           
         case SLIDER:
-          item_slider = elem->item.slider;
+          item_slider = &elem->item.slider;
 	  
+	        colour = COLOUR_PLAIN;
 	        if (i == menu->selection && !engaged) {
-	          wattron(window, COLOR_HIGHLIGHT);
-	          mvwprintw(window, top_offset, left_offset-3, "-->");
+	          colour = COLOUR_HIGHLIGHT;
+	          put_text(backend, top_offset, left_offset-3, "-->", colour);
 	          left_offset = left_offset + 1;
 	        }
 
           // Draw slider text.
-          mvwprintw(window, top_offset, left_offset, item_slider->text);
+          put_text(backend, top_offset, left_offset, item_slider->text, colour);
           top_offset++;
          
 	        if (i == menu->selection && !engaged) {
-	          wattron(window, COLOR_NORMAL);
 	          left_offset = left_offset - 1;
 	        }
           
@@ -258,22 +215,17 @@ menu_refresh (struct menu *menu)
           int slider_left_offset = left_offset + (int)(0.5*left_offset);
           
 	        if (i == menu->selection && engaged) {
-	          wattron(window, COLOR_HIGHLIGHT);
-	          mvwprintw(window, top_offset, slider_left_offset-4, "-->");
-	          wattron(window, COLOR_NORMAL);
+	          put_text(backend, top_offset, slider_left_offset-4, "-->", COLOUR_HIGHLIGHT);
 	        }
 	  
-          mvwaddch(window, top_offset, slider_left_offset, '[');
+          backend->put(backend, top_offset, slider_left_offset, '[', COLOUR_PLAIN);
           int j;
-	  
-	        wattron(window, COLOR_SLIDER);
           
 	        for (j=0; j < item_slider->pos; j++) {
-            mvwaddch(window, top_offset, slider_left_offset+1+j, '=');
+            backend->put(backend, top_offset, slider_left_offset+1+j, '=', COLOUR_SLIDER);
           }
           
-          wattron(window, COLOR_NORMAL);
-          mvwaddch(window, top_offset, slider_left_offset+item_slider->length, ']');
+          backend->put(backend, top_offset, slider_left_offset+item_slider->length, ']', COLOUR_PLAIN);
          
 	        break;
           
@@ -281,9 +233,8 @@ menu_refresh (struct menu *menu)
    
   }
   
-  wattroff(window, COLOR_NORMAL);
-  // Refresh window.
-  wrefresh(window);
+  // Show the frame.
+  backend->present(backend);
   
 }
 
@@ -365,9 +316,6 @@ void
 menu_run (struct menu *menu, struct menu_event *event)
 {
   
-  // Window we're outputting to.
-  WINDOW *window = menu->window;
-  
   // Whether you're engaged on the currently selected menu element.
   // This only makes sense for some types, e.g.: sliders.
   int engaged = menu->engaged;
@@ -404,7 +352,7 @@ menu_run (struct menu *menu, struct menu_event *event)
     
     // Press "left" or "right" while engaged with slider.
     else if (engaged && elem->tag == SLIDER && (ch == KEY_LEFT || ch == KEY_RIGHT)) {
-      item_slider = (elem->item).slider;
+      item_slider = &(elem->item).slider;
       int dir = ch == KEY_LEFT ? -1 : 1;
       int newpos = item_slider->pos + dir;      
       if (newpos >= 0 && newpos < item_slider->length) item_slider->pos = newpos;
@@ -414,7 +362,7 @@ menu_run (struct menu *menu, struct menu_event *event)
     
     // Press "enter"; send key event
     else if (ch == KEY_NL) {
-      item_text = (elem->item).text;     
+      item_text = &(elem->item).text;     
       if (item_text->exit) _EXIT_EVENT(event, elem);
       else _TEXT_EVENT(event, elem);
       return;
@@ -1,4 +1,6 @@
 
+#include "render.h"
+
 enum item_type { SLIDER, TEXT };
 
 struct item_slider {
@@ -15,14 +17,14 @@ struct item_text {
 struct menu_item {
   enum item_type tag;
   union {
-    struct item_text *text;
-    struct item_slider *slider;
+    struct item_text text;
+    struct item_slider slider;
   } item;
 };
 
 struct menu {
   int indent_size;
-  WINDOW *window;
+  struct backend *backend;
   struct menu_item **items;
   int num_items;
   int selection;
@@ -46,9 +48,7 @@ typedef struct menu_item ITEM;
 void make_item_text (ITEM *item, char *text);
 void make_item_exit (ITEM *item, char *text);
 void make_item_slider (ITEM *item, char *text, int length);
-void make_menu (MENU *menu, WINDOW *window, ITEM **items, int num_items);
-void free_elem (ITEM *item);
-void free_menu (MENU *menu);
+void make_menu (MENU *menu, struct backend *backend, ITEM **items, int num_items);
 void menu_run (MENU *menu, EVENT *event);
 void menu_refresh (MENU *menu);
 void menu_init_colours();
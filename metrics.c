@@ -0,0 +1,157 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <stdio.h>
+
+#include "metrics.h"
+
+// ------------------------------------------------------------
+// Globals.
+// ------------------------------------------------------------
+
+// Whether phases are being timed. Set from the command line.
+int metrics_enabled = 0;
+
+struct metrics metrics;
+
+
+
+// ------------------------------------------------------------
+// Histogram functions.
+// ------------------------------------------------------------
+
+/*  Get the bucket a value falls in. */
+static int
+bucket_of (uint64_t value)
+{
+  if (value < HIST_SUB) return value;
+  int exp = 63 - __builtin_clzll(value);
+  int sub = (value >> (exp - HIST_SUB_BITS)) & (HIST_SUB - 1);
+  return (exp - HIST_SUB_BITS + 1) * HIST_SUB + sub;
+}
+
+/*  Get the largest value which falls in a bucket. */
+static uint64_t
+bucket_top (int bucket)
+{
+  if (bucket < HIST_SUB) return bucket;
+  int exp = bucket / HIST_SUB + HIST_SUB_BITS - 1;
+  uint64_t sub = bucket % HIST_SUB;
+  uint64_t base = (uint64_t) 1 << exp;
+  uint64_t width = base >> HIST_SUB_BITS;
+  return base + (sub + 1) * width - 1;
+}
+
+/*  Read a field of a histogram, which may be being recorded into. */
+uint64_t
+hist_read (_Atomic uint64_t *field)
+{
+  return atomic_load_explicit(field, memory_order_relaxed);
+}
+
+/*  Set a field of a histogram. Only the thread recording into it may. */
+static inline void
+hist_write (_Atomic uint64_t *field, uint64_t value)
+{
+  atomic_store_explicit(field, value, memory_order_relaxed);
+}
+
+void
+hist_record (struct histogram *hist, uint64_t value)
+{
+  _Atomic uint64_t *bucket = &hist->counts[bucket_of(value)];
+  hist_write(bucket, hist_read(bucket) + 1);
+  hist_write(&hist->count, hist_read(&hist->count) + 1);
+  hist_write(&hist->total, hist_read(&hist->total) + value);
+  if (value > hist_read(&hist->max)) hist_write(&hist->max, value);
+}
+
+/*  Get the value which percent of the recorded values are at or below.
+    This is the top of the bucket it falls in, capped at the largest value
+    recorded. */
+uint64_t
+hist_percentile (struct histogram *hist, double percent)
+{
+  uint64_t count = hist_read(&hist->count);
+  uint64_t max = hist_read(&hist->max);
+  if (count == 0) return 0;
+  uint64_t want = count * percent / 100;
+  if (want < 1) want = 1;
+  uint64_t seen = 0;
+  int i;
+  for (i=0; i<HIST_BUCKETS; i++) {
+    seen += hist_read(&hist->counts[i]);
+    if (seen >= want) {
+      uint64_t top = bucket_top(i);
+      return top < max ? top : max;
+    }
+  }
+  return max;
+}
+
+
+
+// ------------------------------------------------------------
+// Metrics functions.
+// ------------------------------------------------------------
+
+char *
+phase_name (Phase phase)
+{
+  switch (phase) {
+    case PHASE_INPUT: return "input";
+    case PHASE_STEP: return "step";
+    case PHASE_FOOD: return "food";
+    case PHASE_DRAW: return "draw";
+    case PHASE_REFRESH: return "refresh";
+    case PHASE_LATENCY: return "latency";
+    case PHASE_LATE: return "late";
+    case PHASE_MINIMAP: return "minimap";
+    case PHASE_AUTOPILOT: return "pilot";
+    default: return "?";
+  }
+}
+
+/*  Record that a phase took ns nanoseconds. */
+void
+metrics_record (Phase phase, int64_t ns)
+{
+  hist_record(&metrics.phases[phase], ns < 0 ? 0 : ns);
+}
+
+/*  Write a summary of every phase and how many frames were drawn and
+    skipped, followed by each phase's non-empty buckets, as plain text. */
+void
+metrics_dump (FILE *out)
+{
+  fprintf(out, "%-8s %10s %10s %10s %10s %10s %10s\n",
+          "phase", "count", "mean_ns", "p50_ns", "p99_ns", "p99.9_ns", "max_ns");
+  Phase p;
+  for (p=0; p<NUM_PHASES; p++) {
+    struct histogram *hist = &metrics.phases[p];
+    uint64_t count = hist_read(&hist->count);
+    fprintf(out, "%-8s %10llu %10llu %10llu %10llu %10llu %10llu\n",
+            phase_name(p), (unsigned long long) count,
+            (unsigned long long) (count ? hist_read(&hist->total) / count : 0),
+            (unsigned long long) hist_percentile(hist, 50),
+            (unsigned long long) hist_percentile(hist, 99),
+            (unsigned long long) hist_percentile(hist, 99.9),
+            (unsigned long long) hist_read(&hist->max));
+  }
+
+  fprintf(out, "\nframes: %ld\nframes skipped: %ld\n",
+          metrics.frames, metrics.frames_skipped);
+
+  for (p=0; p<NUM_PHASES; p++) {
+    struct histogram *hist = &metrics.phases[p];
+    fprintf(out, "\n%s: bucket_top_ns count\n", phase_name(p));
+    int i;
+    for (i=0; i<HIST_BUCKETS; i++) {
+      uint64_t n = hist_read(&hist->counts[i]);
+      if (n == 0) continue;
+      fprintf(out, "%llu %llu\n", (unsigned long long) bucket_top(i),
+              (unsigned long long) n);
+    }
+  }
+}
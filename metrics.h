@@ -0,0 +1,100 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// Histogram buckets are log-linear: values below HIST_SUB get a bucket
+// each, and every power of two above that is split into HIST_SUB buckets,
+// so a value is never more than 1/HIST_SUB out.
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// The parts of a tick of play_game which are timed, how long a key takes
+// to reach the snake, and how late steps are.
+typedef enum {
+  PHASE_INPUT,   // process_input
+  PHASE_STEP,    // game_step, less the food placement inside it
+  PHASE_FOOD,    // randomise_food
+  PHASE_DRAW,    // drawing the damaged cells and the HUD
+  PHASE_REFRESH, // wrefresh
+  PHASE_LATENCY, // from a key being read to the step which acts on it
+  PHASE_LATE,    // from when a step was due to when it started
+  PHASE_MINIMAP, // summarise_board
+  PHASE_AUTOPILOT, // autopilot_next
+  NUM_PHASES
+} Phase;
+
+// A histogram of durations in nanoseconds. Only one thread records into
+// a histogram, but another may read it while it does, to show it; so
+// every field is atomic, and accessed relaxed, which costs the writer
+// nothing over plain loads and stores.
+struct histogram {
+  _Atomic uint64_t counts[HIST_BUCKETS];
+  _Atomic uint64_t count;
+  _Atomic uint64_t total;
+  _Atomic uint64_t max;
+};
+
+// Timings for every phase, and how many frames were drawn and skipped.
+// There is one set for the whole process; it is only filled in by the
+// interactive game, where each phase is recorded by either the thread
+// playing it or the thread drawing it.
+struct metrics {
+  struct histogram phases[NUM_PHASES];
+  long int frames;
+  long int frames_skipped;
+};
+
+// ------------------------------------------------------------
+// Globals.
+// ------------------------------------------------------------
+
+extern int metrics_enabled;
+extern struct metrics metrics;
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+void hist_record (struct histogram *hist, uint64_t value);
+uint64_t hist_percentile (struct histogram *hist, double percent);
+uint64_t hist_read (_Atomic uint64_t *field);
+void metrics_record (Phase phase, int64_t ns);
+void metrics_dump (FILE *out);
+char *phase_name (Phase phase);
+
+/*  Start timing a phase. Returns zero straight away, without reading the
+    clock, if metrics are turned off. */
+static inline int64_t
+metrics_begin (void)
+{
+  if (!metrics_enabled) return 0;
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return (int64_t) tp.tv_sec * 1000000000 + tp.tv_nsec;
+}
+
+/*  Finish timing a phase started with metrics_begin, and return how long
+    it took in nanoseconds. */
+static inline int64_t
+metrics_end (Phase phase, int64_t start)
+{
+  if (!metrics_enabled) return 0;
+  int64_t ns = metrics_begin() - start;
+  metrics_record(phase, ns);
+  return ns;
+}
+
+#endif
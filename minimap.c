@@ -0,0 +1,219 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+#include "minimap.h"
+
+
+
+// ------------------------------------------------------------
+// Popcount kernels.
+// ------------------------------------------------------------
+
+/*  Count bits a word at a time, however the compiler manages it without
+    assuming anything about the CPU. */
+static void
+count_plain (const uint64_t *bits, int words_per_row, int rows, uint64_t *counts)
+{
+  int r, w;
+  for (r=0; r<rows; r++) {
+    const uint64_t *row = bits + (size_t) r * words_per_row;
+    for (w=0; w<words_per_row; w++) counts[w] += __builtin_popcountll(row[w]);
+  }
+}
+
+static int
+always (void)
+{
+  return 1;
+}
+
+#ifdef HAVE_X86
+
+/*  Count bits a word at a time with the popcnt instruction. */
+__attribute__((target("popcnt")))
+static void
+count_popcnt (const uint64_t *bits, int words_per_row, int rows, uint64_t *counts)
+{
+  int r, w;
+  for (r=0; r<rows; r++) {
+    const uint64_t *row = bits + (size_t) r * words_per_row;
+    for (w=0; w<words_per_row; w++) counts[w] += __builtin_popcountll(row[w]);
+  }
+}
+
+static int
+has_popcnt (void)
+{
+  return __builtin_cpu_supports("popcnt");
+}
+
+/*  Count bits four words at a time. Each nibble's bits are looked up in a
+    table with a shuffle, and the bytes of each word summed with sad, so
+    the counts for four words come out in the four lanes of a register,
+    lined up with the words they're for. */
+__attribute__((target("avx2,popcnt")))
+static void
+count_avx2 (const uint64_t *bits, int words_per_row, int rows, uint64_t *counts)
+{
+  const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  int r, w;
+  for (r=0; r<rows; r++) {
+    const uint64_t *row = bits + (size_t) r * words_per_row;
+    for (w=0; w+4<=words_per_row; w+=4) {
+      __m256i v = _mm256_loadu_si256((const __m256i *) (row + w));
+      __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+      __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+      __m256i sums = _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero);
+      __m256i *to = (__m256i *) (counts + w);
+      _mm256_storeu_si256(to, _mm256_add_epi64(_mm256_loadu_si256(to), sums));
+    }
+    for (; w<words_per_row; w++) counts[w] += __builtin_popcountll(row[w]);
+  }
+}
+
+static int
+has_avx2 (void)
+{
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+}
+
+#endif
+
+// Every kernel, fastest first.
+struct popcount_kernel popcount_kernels[] = {
+#ifdef HAVE_X86
+  { "avx2", count_avx2, has_avx2 },
+  { "popcnt", count_popcnt, has_popcnt },
+#endif
+  { "plain", count_plain, always },
+};
+
+int num_popcount_kernels = sizeof(popcount_kernels) / sizeof(popcount_kernels[0]);
+
+/*  Get the fastest kernel the CPU can run. */
+struct popcount_kernel *
+best_popcount_kernel (void)
+{
+  int i;
+  for (i=0; i<num_popcount_kernels; i++) {
+    if (popcount_kernels[i].supported()) return &popcount_kernels[i];
+  }
+  return &popcount_kernels[num_popcount_kernels - 1];
+}
+
+
+
+// ------------------------------------------------------------
+// Minimap functions.
+// ------------------------------------------------------------
+
+/*  Get a/b rounded up. */
+static inline int
+div_up (int a, int b)
+{
+  return (a + b - 1) / b;
+}
+
+/*  Set up a minimap of a bit-packed board of board_ht rows by board_wd
+    cells. */
+void
+init_minimap (struct minimap *map, int board_ht, int board_wd)
+{
+  map->cols = board_wd < MINIMAP_COLS ? board_wd : MINIMAP_COLS;
+  map->board_wd = board_wd;
+  map->rows = board_ht < MINIMAP_ROWS ? board_ht : MINIMAP_ROWS;
+  map->band_ht = div_up(board_ht, map->rows);
+  map->rows = div_up(board_ht, map->band_ht);
+  map->head_row = 0;
+  map->head_col = 0;
+  map->dirty = ((uint32_t) 1 << map->rows) - 1;
+  memset(map->level, 0, sizeof map->level);
+}
+
+/*  Note that a row of the board has changed. */
+void
+touch_minimap (struct minimap *map, int board_row)
+{
+  map->dirty |= (uint32_t) 1 << (board_row / map->band_ht);
+}
+
+/*  Get the first cell across the board that column c of a minimap covers.
+    Cell x is in column x * cols / board_wd. */
+static inline int
+column_start (struct minimap *map, int c)
+{
+  return div_up(c * map->board_wd, map->cols);
+}
+
+/*  Count the bits of word w of each of rows rows which are in mask. */
+static uint64_t
+count_masked (const uint64_t *bits, int words_per_row, int rows, int w, uint64_t mask)
+{
+  uint64_t set = 0;
+  int r;
+  for (r=0; r<rows; r++) set += __builtin_popcountll(bits[(size_t) r * words_per_row + w] & mask);
+  return set;
+}
+
+/*  Count the bits down a band in word w between bits lo and hi, using the
+    kernel's count if that's the whole word. */
+static uint64_t
+count_word (const uint64_t *bits, int words_per_row, int rows, uint64_t *counts,
+            int w, int lo, int hi)
+{
+  if (lo == 0 && hi == 63) return counts[w];
+  uint64_t mask = (~(uint64_t) 0 << lo) & (~(uint64_t) 0 >> (63 - hi));
+  return count_masked(bits, words_per_row, rows, w, mask);
+}
+
+/*  Work out how full each cell of a minimap is from a bit-packed board,
+    one band of rows at a time: the kernel adds up the bits in each word
+    down the band, then the words are added up across each cell. A cell's
+    edges needn't fall between words, so the words at its edges are
+    counted again through a mask. Only the bands which have been touched
+    are counted. counts must have room for a row's words. */
+void
+summarise_board (struct minimap *map, struct popcount_kernel *kernel,
+                 const uint64_t *bits, int words_per_row, int board_ht,
+                 int head_row, int head_col, uint64_t *counts)
+{
+  int r, c, w;
+  for (r=0; r<map->rows; r++) {
+    if (!(map->dirty & ((uint32_t) 1 << r))) continue;
+    int top = r * map->band_ht;
+    int ht = board_ht - top < map->band_ht ? board_ht - top : map->band_ht;
+    const uint64_t *band = bits + (size_t) top * words_per_row;
+    memset(counts, 0, words_per_row * sizeof *counts);
+    kernel->count(band, words_per_row, ht, counts);
+
+    for (c=0; c<map->cols; c++) {
+      int first = column_start(map, c), last = column_start(map, c + 1) - 1;
+      int wFirst = first / 64, wLast = last / 64;
+      uint64_t set;
+      if (wFirst == wLast) {
+        set = count_word(band, words_per_row, ht, counts, wFirst, first % 64, last % 64);
+      }
+      else {
+        set = count_word(band, words_per_row, ht, counts, wFirst, first % 64, 63);
+        for (w=wFirst+1; w<wLast; w++) set += counts[w];
+        set += count_word(band, words_per_row, ht, counts, wLast, 0, last % 64);
+      }
+      uint64_t cells = (uint64_t) ht * (last - first + 1);
+      map->level[r * map->cols + c] = set == 0 ? 0 : 1 + set * (MINIMAP_LEVELS - 2) / cells;
+    }
+  }
+  map->dirty = 0;
+  map->head_row = head_row / map->band_ht;
+  map->head_col = (long int) head_col * map->cols / map->board_wd;
+}
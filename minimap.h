@@ -0,0 +1,71 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <stdint.h>
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// most rows and columns a minimap has
+#define MINIMAP_ROWS 8
+#define MINIMAP_COLS 15
+
+// how many levels of fullness a minimap cell shows
+#define MINIMAP_LEVELS 9
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// Adds the number of bits set in each word of rows rows of a bit-packed
+// board, words_per_row words a row, to counts[word].
+typedef void (*popcount_fn) (const uint64_t *bits, int words_per_row, int rows,
+                             uint64_t *counts);
+
+// A way of counting bits, which the CPU may or may not be able to run.
+struct popcount_kernel {
+  char *name;
+  popcount_fn count;
+  int (*supported) (void);
+};
+
+// The whole of a board shrunk down, each cell covering band_ht rows and an
+// even share of the board_wd cells across the board, and holding how full
+// that block is, from 0 (empty) to MINIMAP_LEVELS-1 (full). The cell the
+// snake's head is in is (head_row, head_col). A minimap with no rows isn't
+// shown.
+//
+// Bit r of dirty is set if the board may have changed in the minimap's
+// row r since it was last summed up, so only those bands of the board are
+// counted again.
+struct minimap {
+  int rows;
+  int cols;
+  int band_ht;
+  int board_wd;
+  int head_row;
+  int head_col;
+  uint32_t dirty;
+  unsigned char level[MINIMAP_ROWS * MINIMAP_COLS];
+};
+
+// ------------------------------------------------------------
+// Globals.
+// ------------------------------------------------------------
+
+extern struct popcount_kernel popcount_kernels[];
+extern int num_popcount_kernels;
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+struct popcount_kernel *best_popcount_kernel (void);
+void init_minimap (struct minimap *map, int board_ht, int board_wd);
+void touch_minimap (struct minimap *map, int board_row);
+void summarise_board (struct minimap *map, struct popcount_kernel *kernel,
+                      const uint64_t *bits, int words_per_row, int board_ht,
+                      int head_row, int head_col, uint64_t *counts);
+
+#endif
@@ -0,0 +1,112 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <ncurses.h>
+
+#include "render.h"
+
+// ------------------------------------------------------------
+// Globals.
+// ------------------------------------------------------------
+
+long int terminal_bytes = 0;
+
+
+
+// ------------------------------------------------------------
+// Drawing helpers.
+// ------------------------------------------------------------
+
+/*  Draw text in a colour a cell at a time, leaving the rest of the row
+    as it is. */
+void
+put_text (struct backend *backend, int row, int col, char *text, Colour colour)
+{
+  for (; *text != '\0'; col++, text++) backend->put(backend, row, col, *text, colour);
+}
+
+
+
+// ------------------------------------------------------------
+// ncurses backend.
+// ------------------------------------------------------------
+
+/*  Set up the colour pairs used to draw the game with ncurses. */
+void
+curses_init_colours (void)
+{
+  init_pair(1, COLOR_WHITE, COLOR_WHITE); // snake colour
+  init_pair(2, COLOR_CYAN, COLOR_CYAN); // wall colour
+  init_pair(3, COLOR_RED, COLOR_RED); // food colour
+}
+
+static void
+curses_put (struct backend *backend, int row, int col, char c, Colour colour)
+{
+  WINDOW *window = backend->data;
+  attr_t attr = 0;
+  switch (colour) {
+    case COLOUR_SNAKE: attr = COLOR_SNAKE; break;
+    case COLOUR_WALL: attr = COLOR_WALL; break;
+    case COLOUR_FOOD: attr = COLOR_FOOD; break;
+    case COLOUR_HIGHLIGHT: attr = COLOR_HIGHLIGHT; break;
+    case COLOUR_SLIDER: attr = COLOR_SLIDER; break;
+    default: break;
+  }
+  if (attr) wattron(window, attr);
+  mvwaddch(window, row, col, c);
+  if (attr) wattroff(window, attr);
+}
+
+static void
+curses_print (struct backend *backend, int row, int col, char *text)
+{
+  WINDOW *window = backend->data;
+  mvwprintw(window, row, col, "%s", text);
+  wclrtoeol(window);
+}
+
+static void
+curses_blank (struct backend *backend)
+{
+  wclear((WINDOW *) backend->data);
+}
+
+static void
+curses_resize (struct backend *backend, int rows, int cols)
+{
+  // resizeterm has already resized the window.
+}
+
+/*  Refresh the window, counting what ncurses writes to do it. */
+static int
+curses_present (struct backend *backend)
+{
+  long int before = terminal_bytes;
+  int ok = wrefresh((WINDOW *) backend->data) != ERR;
+  backend->bytes += terminal_bytes - before;
+  return ok;
+}
+
+static void
+curses_close (struct backend *backend)
+{
+}
+
+/*  Set up a backend which draws on an ncurses window. ncurses keeps its
+    own copy of the screen and sends only what changed on a refresh, but
+    every cell drawn is a separate call, with its own attribute changes. */
+void
+init_curses_backend (struct backend *backend, WINDOW *window)
+{
+  backend->name = "curses";
+  backend->put = curses_put;
+  backend->print = curses_print;
+  backend->blank = curses_blank;
+  backend->resize = curses_resize;
+  backend->present = curses_present;
+  backend->close = curses_close;
+  backend->data = window;
+  backend->bytes = 0;
+}
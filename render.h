@@ -0,0 +1,120 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <ncurses.h>
+#include <stddef.h>
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// colour pairs used by the ncurses backend
+#define COLOR_SNAKE COLOR_PAIR(1)
+#define COLOR_WALL COLOR_PAIR(2)
+#define COLOR_FOOD COLOR_PAIR(3)
+#define COLOR_HIGHLIGHT COLOR_PAIR(11)
+#define COLOR_SLIDER COLOR_PAIR(12)
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// The colours a cell can be drawn in. Plain is the terminal's own. The
+// last two are for the menu's selected item and its sliders.
+typedef enum {
+  COLOUR_PLAIN, COLOUR_SNAKE, COLOUR_WALL, COLOUR_FOOD,
+  COLOUR_HIGHLIGHT, COLOUR_SLIDER, NUM_COLOURS
+} Colour;
+
+// Something the game can be drawn on. A frame is built up with put and
+// print, which only change what the backend will show, then sent to the
+// terminal in one go by present, which returns zero if it couldn't be.
+// blank clears the whole frame. resize tells the backend the terminal has
+// changed size, so it must repaint everything. close frees whatever the
+// backend holds, but leaves the terminal as it is. bytes is how many bytes
+// present has sent to the terminal so far.
+struct backend {
+  char *name;
+  void (*put) (struct backend *, int row, int col, char c, Colour colour);
+  void (*print) (struct backend *, int row, int col, char *text);
+  void (*blank) (struct backend *);
+  void (*resize) (struct backend *, int rows, int cols);
+  int (*present) (struct backend *);
+  void (*close) (struct backend *);
+  void *data;
+  long int bytes;
+};
+
+// A cell of a frame held in memory.
+struct cell {
+  char c;
+  unsigned char colour;
+};
+
+// Draws by writing ANSI escape sequences straight to a file descriptor.
+// back is the frame being built and front what the terminal is showing;
+// present sends only the cells which differ. out holds a frame's output
+// until it is written, all at once. The cursor and colour the terminal
+// was left with are remembered, so that moving the cursor and changing
+// colour can be left out where they aren't needed. If invalid is set the
+// terminal's contents aren't known, and the next frame starts by clearing
+// it.
+struct ansi_screen {
+  int fd;
+  int rows;
+  int cols;
+  struct cell *front;
+  struct cell *back;
+  int *changed;
+  char *out;
+  size_t out_len;
+  size_t out_size;
+  int cursor_row;
+  int cursor_col;
+  Colour colour;
+  int invalid;
+};
+
+// What a null backend has been asked to draw, which is all it does.
+struct null_counts {
+  long int cells;
+  long int frames;
+};
+
+// Draws into a buffer of text, which may be a file mapped into memory, so
+// that frames can be compared with ones known to be right. The buffer has
+// a line for each row of the frame holding its characters, then a line
+// for each row holding its colours as digits. path is NULL if the buffer
+// is only in memory.
+struct frame_buffer {
+  char *path;
+  int rows;
+  int cols;
+  char *text;
+  size_t size;
+  long int frames;
+};
+
+// ------------------------------------------------------------
+// Globals.
+// ------------------------------------------------------------
+
+// Bytes written to the terminal, which ncurses writes to itself. A
+// program which wraps write to count them keeps this up; if nothing does,
+// the curses backend says it sent nothing.
+extern long int terminal_bytes;
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+void curses_init_colours (void);
+void init_curses_backend (struct backend *backend, WINDOW *window);
+void init_ansi_backend (struct backend *backend, struct ansi_screen *screen,
+                        int fd, int rows, int cols);
+void init_null_backend (struct backend *backend, struct null_counts *counts);
+int init_frame_backend (struct backend *backend, struct frame_buffer *frame,
+                        char *path, int rows, int cols);
+void put_text (struct backend *backend, int row, int col, char *text, Colour colour);
+
+#endif
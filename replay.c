@@ -0,0 +1,280 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "replay.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// most bytes a varint can take before its value wouldn't fit in a long
+#define MAX_VARINT_BYTES 9
+
+
+
+// ------------------------------------------------------------
+// Encoding functions.
+// ------------------------------------------------------------
+
+/*  Write a number into n bytes, little-endian. */
+static void
+put_le (unsigned char *to, uint64_t value, int n)
+{
+  int i;
+  for (i=0; i<n; i++) to[i] = value >> (8 * i);
+}
+
+/*  Read a number from n bytes, little-endian. */
+static uint64_t
+get_le (const unsigned char *from, int n)
+{
+  uint64_t value = 0;
+  int i;
+  for (i=0; i<n; i++) value |= (uint64_t) from[i] << (8 * i);
+  return value;
+}
+
+/*  Read the varint starting at turns[*at], moving *at past it. Returns -1
+    if the bytes run out or there are too many of them. */
+static long int
+get_varint (const unsigned char *turns, size_t size, size_t *at)
+{
+  long int value = 0;
+  int i;
+  for (i=0; i<MAX_VARINT_BYTES && *at < size; i++) {
+    unsigned char b = turns[(*at)++];
+    value |= (long int) (b & 0x7f) << (7 * i);
+    if (!(b & 0x80)) return value;
+  }
+  return -1;
+}
+
+
+
+// ------------------------------------------------------------
+// Recording functions.
+// ------------------------------------------------------------
+
+/*  Start recording a game on a board, seeded with seed and stepping every
+    step_ns nanoseconds. The turns are kept in the arena. */
+void
+init_replay (struct replay *replay, struct arena *arena,
+             struct game_data *game, uint64_t seed, int64_t step_ns)
+{
+  replay->seed = seed;
+  replay->step_ns = step_ns;
+  replay->board_ht = game->WALL_HT;
+  replay->board_wd = game->WALL_WD;
+  replay->difficulty = game->difficulty;
+  replay->unbounded = game->unbounded;
+  replay->outcome = PLAYING;
+  replay->ticks = 0;
+  replay->score = 0;
+  replay->length = 0;
+  replay->arena = arena;
+  replay->turns = arena_alloc(arena, REPLAY_MIN_BYTES);
+  replay->size = 0;
+  replay->capacity = REPLAY_MIN_BYTES;
+  replay->last_tick = -1;
+  replay->map = NULL;
+}
+
+/*  Add a byte to a recording's turns, doubling the room for them if it has
+    run out. The old room stays in the arena, which at most doubles what
+    the turns take. */
+static void
+put_byte (struct replay *replay, unsigned char b)
+{
+  if (replay->size == replay->capacity) {
+    unsigned char *more = arena_alloc(replay->arena, 2 * replay->capacity);
+    memcpy(more, replay->turns, replay->size);
+    replay->turns = more;
+    replay->capacity *= 2;
+  }
+  ((unsigned char *) replay->turns)[replay->size++] = b;
+}
+
+/*  Record that the snake was turned to dir on the step made at tick. Turns
+    must be recorded in the order they were made, at most one a tick. */
+void
+record_turn (struct replay *replay, long int tick, Direction dir)
+{
+  uint64_t value = (uint64_t) (tick - replay->last_tick) << 2 | dir;
+  replay->last_tick = tick;
+  while (value >= 0x80) {
+    put_byte(replay, (value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  put_byte(replay, value);
+}
+
+/*  Record how a game ended. */
+void
+end_replay (struct replay *replay, struct game_state *state, Outcome outcome)
+{
+  replay->outcome = outcome;
+  replay->ticks = state->ticks;
+  replay->score = state->score;
+  replay->length = state->snake->length;
+}
+
+/*  Write a recording to a file. Returns zero if it couldn't be written. */
+int
+save_replay (struct replay *replay, char *path)
+{
+  unsigned char header[REPLAY_HEADER_SIZE];
+  memcpy(header, REPLAY_MAGIC, 4);
+  header[4] = REPLAY_VERSION;
+  header[5] = replay->difficulty;
+  header[6] = replay->unbounded;
+  header[7] = replay->outcome;
+  put_le(header + 8, replay->board_ht, 4);
+  put_le(header + 12, replay->board_wd, 4);
+  put_le(header + 16, replay->seed, 8);
+  put_le(header + 24, replay->ticks, 8);
+  put_le(header + 32, replay->score, 4);
+  put_le(header + 36, replay->length, 4);
+  put_le(header + 40, replay->step_ns, 8);
+
+  FILE *out = fopen(path, "wb");
+  if (out == NULL) return 0;
+  int ok = fwrite(header, 1, sizeof header, out) == sizeof header &&
+           fwrite(replay->turns, 1, replay->size, out) == replay->size;
+  if (fclose(out) != 0) ok = 0;
+  return ok;
+}
+
+
+
+// ------------------------------------------------------------
+// Playback functions.
+// ------------------------------------------------------------
+
+/*  Read a replay from the bytes of a replay file, which must stay where
+    they are while it's played back. Every record is checked, so a replay
+    which reads without error can be played to the end. Returns zero if
+    the bytes aren't a replay this version can play. */
+int
+read_replay (struct replay *replay, const unsigned char *bytes, size_t size)
+{
+  if (size < REPLAY_HEADER_SIZE) return 0;
+  if (memcmp(bytes, REPLAY_MAGIC, 4) != 0 || bytes[4] != REPLAY_VERSION) return 0;
+  replay->difficulty = bytes[5];
+  replay->unbounded = bytes[6];
+  replay->outcome = bytes[7];
+  replay->board_ht = get_le(bytes + 8, 4);
+  replay->board_wd = get_le(bytes + 12, 4);
+  replay->seed = get_le(bytes + 16, 8);
+  replay->ticks = get_le(bytes + 24, 8);
+  replay->score = get_le(bytes + 32, 4);
+  replay->length = get_le(bytes + 36, 4);
+  replay->step_ns = get_le(bytes + 40, 8);
+  if (replay->board_ht < MIN_BOARD || replay->board_ht > MAX_BOARD) return 0;
+  if (replay->board_wd < MIN_BOARD || replay->board_wd > MAX_BOARD) return 0;
+  if (replay->unbounded > 1 || replay->outcome > WON || replay->ticks < 0) return 0;
+  if (replay->step_ns <= 0) return 0;
+
+  replay->turns = bytes + REPLAY_HEADER_SIZE;
+  replay->size = size - REPLAY_HEADER_SIZE;
+  replay->capacity = replay->size;
+  replay->arena = NULL;
+  replay->map = NULL;
+
+  // Every turn must be made before the game ended.
+  long int tick = -1;
+  size_t at = 0;
+  while (at < replay->size) {
+    long int value = get_varint(replay->turns, replay->size, &at);
+    if (value < 4 || (value >> 2) >= replay->ticks - tick) return 0;
+    tick += value >> 2;
+  }
+  replay->last_tick = tick;
+  rewind_replay(replay);
+  return 1;
+}
+
+/*  Open a replay file, mapping it into memory rather than reading it.
+    Returns zero if it couldn't be opened or isn't a replay, with errno
+    set to say why. */
+int
+open_replay (struct replay *replay, char *path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return 0;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return 0;
+  }
+  if (st.st_size < REPLAY_HEADER_SIZE) {
+    close(fd);
+    errno = EINVAL;
+    return 0;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return 0;
+  if (!read_replay(replay, map, st.st_size)) {
+    munmap(map, st.st_size);
+    errno = EINVAL;
+    return 0;
+  }
+  replay->map = map;
+  replay->map_size = st.st_size;
+  return 1;
+}
+
+/*  Let go of a replay file opened with open_replay. */
+void
+close_replay (struct replay *replay)
+{
+  if (replay->map != NULL) munmap(replay->map, replay->map_size);
+  replay->map = NULL;
+}
+
+/*  Set a game up on the board a replay was recorded on. */
+void
+replay_board (struct replay *replay, struct game_data *game)
+{
+  game->WALL_HT = replay->board_ht;
+  game->WALL_WD = replay->board_wd;
+  game->difficulty = replay->difficulty;
+  game->unbounded = replay->unbounded;
+}
+
+/*  Go back to the first turn of a replay. */
+void
+rewind_replay (struct replay *replay)
+{
+  replay->at = 0;
+  replay->next_tick = -1;
+  if (replay->size == 0) return;
+  long int value = get_varint(replay->turns, replay->size, &replay->at);
+  replay->next_tick = (value >> 2) - 1;
+  replay->next_dir = value & 3;
+}
+
+/*  Get the input for the step made at tick, which is dir unless the snake
+    was turned on that step. Steps must be asked about in order. */
+Direction
+replay_input (struct replay *replay, long int tick, Direction dir)
+{
+  if (tick != replay->next_tick) return dir;
+  dir = replay->next_dir;
+  if (replay->at < replay->size) {
+    long int value = get_varint(replay->turns, replay->size, &replay->at);
+    replay->next_tick += value >> 2;
+    replay->next_dir = value & 3;
+  }
+  else replay->next_tick = -1;
+  return dir;
+}
@@ -0,0 +1,97 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "game.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// what every replay file starts with, and the version of the format
+#define REPLAY_MAGIC "SNKR"
+#define REPLAY_VERSION 2
+
+// bytes in the header of a replay file
+#define REPLAY_HEADER_SIZE 48
+
+// bytes of turns a new recording has room for
+#define REPLAY_MIN_BYTES 256
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// Everything needed to play a game again exactly: its seed, its board, and
+// the turns the snake was given, and to play it back at the speed it went:
+// step_ns, the nanoseconds between its steps. A game is determined by its
+// seed and its inputs, and the only inputs that change anything are turns,
+// so steps with no turn cost nothing to record.
+//
+// A replay file is a header, with every number in it little-endian:
+//
+//   0  "SNKR"            8  board_ht (4)     24  ticks (8)
+//   4  version (2)      12  board_wd (4)     32  score (4)
+//   5  difficulty (1)   16  seed (8)         36  length (4)
+//   6  unbounded (1)                         40  step_ns (8)
+//   7  outcome (1)
+//
+// followed by a record for each turn up to the end of the file. A record
+// is delta << 2 | direction as a varint, seven bits a byte with the low
+// bits first and the top bit set on every byte but the last, where delta
+// is how many ticks the turn came after the one before it. The first turn
+// counts from tick -1, so delta is never zero and a turn every few steps
+// takes a byte. The game ended after ticks steps with outcome, score and
+// length; a game the player quit ends PLAYING.
+//
+// While recording, turns holds size bytes of records in room for capacity,
+// from the arena. While playing back, turns points into the file, which
+// is mapped at map if it was opened with open_replay, and the next turn is
+// next_dir at next_tick, or there are no more if next_tick is -1. at is
+// where the record after that starts.
+struct replay {
+  uint64_t seed;
+  int board_ht;
+  int board_wd;
+  int difficulty;
+  int unbounded;
+  Outcome outcome;
+  long int ticks;
+  int score;
+  int length;
+  int64_t step_ns;
+  const unsigned char *turns;
+  size_t size;
+  size_t capacity;
+  long int last_tick;
+  size_t at;
+  long int next_tick;
+  Direction next_dir;
+  struct arena *arena;
+  void *map;
+  size_t map_size;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+// Recording.
+void init_replay (struct replay *replay, struct arena *arena,
+                  struct game_data *game, uint64_t seed, int64_t step_ns);
+void record_turn (struct replay *replay, long int tick, Direction dir);
+void end_replay (struct replay *replay, struct game_state *state, Outcome outcome);
+int save_replay (struct replay *replay, char *path);
+
+// Playing back.
+int read_replay (struct replay *replay, const unsigned char *bytes, size_t size);
+int open_replay (struct replay *replay, char *path);
+void close_replay (struct replay *replay);
+void replay_board (struct replay *replay, struct game_data *game);
+void rewind_replay (struct replay *replay);
+Direction replay_input (struct replay *replay, long int tick, Direction dir);
+
+#endif
@@ -0,0 +1,313 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "save.h"
+
+
+
+// ------------------------------------------------------------
+// Layout functions.
+// ------------------------------------------------------------
+
+/*  Get an offset rounded up to the alignment of a part of a save file. */
+static inline uint64_t
+align_up (uint64_t offset)
+{
+  return (offset + SAVE_ALIGN - 1) & ~(uint64_t) (SAVE_ALIGN - 1);
+}
+
+/*  Work out where each array goes in a save file of a game on a board,
+    for a snake with room for capacity segments and with or without a
+    free set, filling in the offsets and size of a header. */
+static void
+lay_out (struct save_header *h, int capacity, int has_free_set)
+{
+  uint64_t cells = (uint64_t) h->board_ht * h->board_wd;
+  uint64_t at = align_up(sizeof (struct save_header));
+  h->body = at;
+  at = align_up(at + (uint64_t) capacity * sizeof (struct point));
+  h->occupied = h->bits = h->free_cells = h->free_pos = 0;
+  if (!h->unbounded) {
+    h->occupied = at;
+    at = align_up(at + cells);
+    h->bits = at;
+    at = align_up(at + (uint64_t) h->board_ht * h->words_per_row * sizeof (uint64_t));
+    if (has_free_set) {
+      h->free_cells = at;
+      at = align_up(at + (uint64_t) (h->board_ht - 2) * (h->board_wd - 2) * sizeof (int));
+      h->free_pos = at;
+      at = align_up(at + cells * sizeof (int));
+    }
+  }
+  h->size = at;
+}
+
+
+
+// ------------------------------------------------------------
+// Saving.
+// ------------------------------------------------------------
+
+/*  Write a game in progress to a file, through a mapping of it. The game
+    goes into a file next to it first, which then takes its place, so a
+    save cut short never leaves a broken file behind. Returns zero if the
+    game couldn't be saved. */
+int
+save_game (struct game_state *state, char *path)
+{
+  struct game_data *game = state->game;
+  struct snake *snake = state->snake;
+  struct save_header h;
+  memset(&h, 0, sizeof h);
+  memcpy(h.magic, SAVE_MAGIC, 4);
+  h.version = SAVE_VERSION;
+  h.header_size = sizeof h;
+  h.board_ht = game->WALL_HT;
+  h.board_wd = game->WALL_WD;
+  h.difficulty = game->difficulty;
+  h.unbounded = game->unbounded;
+  h.dir = state->dir;
+  h.ate_food = state->ate_food;
+  h.score = state->score;
+  h.words_per_row = snake->words_per_row;
+  h.ticks = state->ticks;
+  h.rng = state->rng.state;
+  h.food = state->food;
+  h.capacity = snake->capacity;
+  h.head = snake->head;
+  h.length = snake->length;
+  h.num_free = snake->num_free;
+  lay_out(&h, snake->capacity, snake->free_cells != NULL);
+
+  char temp[4096];
+  snprintf(temp, sizeof temp, "%s.tmp", path);
+  int fd = open(temp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return 0;
+  if (ftruncate(fd, h.size) != 0) {
+    close(fd);
+    unlink(temp);
+    return 0;
+  }
+  char *map = mmap(NULL, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    unlink(temp);
+    return 0;
+  }
+
+  uint64_t cells = (uint64_t) h.board_ht * h.board_wd;
+  memcpy(map, &h, sizeof h);
+  memcpy(map + h.body, snake->body, (size_t) h.capacity * sizeof (struct point));
+  if (h.occupied) memcpy(map + h.occupied, snake->occupied, cells);
+  if (h.bits) {
+    memcpy(map + h.bits, snake->bits,
+           (size_t) h.board_ht * h.words_per_row * sizeof (uint64_t));
+  }
+  if (h.free_cells) {
+    memcpy(map + h.free_cells, snake->free_cells,
+           (size_t) (h.board_ht - 2) * (h.board_wd - 2) * sizeof (int));
+    memcpy(map + h.free_pos, snake->free_pos, cells * sizeof (int));
+  }
+  int ok = munmap(map, h.size) == 0;
+  if (ok) ok = rename(temp, path) == 0;
+  else unlink(temp);
+  return ok;
+}
+
+
+
+// ------------------------------------------------------------
+// Loading.
+// ------------------------------------------------------------
+
+/*  Get the index of a point in a snake's occupancy grid. */
+static inline int
+cell_of (struct snake *snake, struct point p)
+{
+  return p.row * snake->board_wd + p.col;
+}
+
+/*  Check that a save file's header describes a game that can be played,
+    with its arrays laid out where this version would put them, inside a
+    file of size bytes. */
+static int
+valid_header (struct save_header *h, size_t size)
+{
+  if (memcmp(h->magic, SAVE_MAGIC, 4) != 0 || h->version != SAVE_VERSION) return 0;
+  if (h->header_size != sizeof *h || h->size != size) return 0;
+  if (h->board_ht < MIN_BOARD || h->board_ht > MAX_BOARD) return 0;
+  if (h->board_wd < MIN_BOARD || h->board_wd > MAX_BOARD) return 0;
+  if (h->unbounded != 0 && h->unbounded != 1) return 0;
+  if (h->dir < NORTH || h->dir > WEST || h->ticks < 0 || h->rng == 0) return 0;
+  if (!h->unbounded && (h->food.row < 1 || h->food.row >= h->board_ht - 1 ||
+                        h->food.col < 1 || h->food.col >= h->board_wd - 1)) return 0;
+  if (h->capacity < 1 || (h->capacity & (h->capacity - 1)) != 0) return 0;
+  if (h->head < 0 || h->head >= h->capacity) return 0;
+  if (h->length < 1 || h->length > h->capacity) return 0;
+  if (!h->unbounded && h->words_per_row != (h->board_wd + 63) / 64) return 0;
+  if (!h->unbounded && (h->num_free < 0 ||
+                        h->num_free > (h->board_ht - 2) * (h->board_wd - 2))) return 0;
+
+  struct save_header expect = *h;
+  lay_out(&expect, h->capacity, h->free_cells != 0);
+  return expect.size == h->size && expect.body == h->body &&
+         expect.occupied == h->occupied && expect.bits == h->bits &&
+         expect.free_cells == h->free_cells && expect.free_pos == h->free_pos;
+}
+
+/*  Check that every segment of a loaded snake is somewhere it could be:
+    inside the walls of a bounded board. */
+static int
+valid_body (struct snake *snake, struct game_data *game)
+{
+  if (snake->chunks != NULL) return 1;
+  int i;
+  for (i=0; i<snake->length; i++) {
+    struct point p = snake_segment(snake, i);
+    if (p.row < 1 || p.row >= game->WALL_HT - 1) return 0;
+    if (p.col < 1 || p.col >= game->WALL_WD - 1) return 0;
+  }
+  return 1;
+}
+
+/*  Check that a loaded snake's occupancy grid, bit board and free set are
+    the ones its segments make, since the game writes through them. Taking
+    every segment off the grid must leave it empty, so it counts exactly
+    the segments on each cell; the bits set must be the cells taken; and
+    the free set must list every other cell inside the walls once, at the
+    place free_pos says. The grid is put back as it was. */
+static int
+valid_board (struct snake *snake, struct game_data *game)
+{
+  if (snake->chunks != NULL) return 1;
+  int cells = game->WALL_HT * game->WALL_WD;
+  int i, c;
+  for (i=0; i<snake->length; i++) {
+    c = cell_of(snake, snake_segment(snake, i));
+    if (snake->occupied[c]-- == 0) return 0;
+  }
+  for (c=0; c<cells; c++) {
+    if (snake->occupied[c] != 0) return 0;
+  }
+
+  int taken = 0;
+  for (i=0; i<snake->length; i++) {
+    struct point p = snake_segment(snake, i);
+    c = cell_of(snake, p);
+    if (snake->occupied[c]++ != 0) continue;
+    taken++;
+    if (!(snake->bits[(size_t) p.row * snake->words_per_row + p.col / 64] >> (p.col % 64) & 1)) return 0;
+  }
+  long int set = 0;
+  size_t w, words = (size_t) game->WALL_HT * snake->words_per_row;
+  for (w=0; w<words; w++) set += __builtin_popcountll(snake->bits[w]);
+  if (set != taken) return 0;
+
+  if (snake->num_free != (game->WALL_HT - 2) * (game->WALL_WD - 2) - taken) return 0;
+  if (snake->free_cells == NULL) return 1;
+  for (i=0; i<snake->num_free; i++) {
+    c = snake->free_cells[i];
+    int row = c / game->WALL_WD, col = c % game->WALL_WD;
+    if (c < 0 || row < 1 || row >= game->WALL_HT - 1 || col < 1 || col >= game->WALL_WD - 1) return 0;
+    if (snake->occupied[c] != 0 || snake->free_pos[c] != i) return 0;
+  }
+  return 1;
+}
+
+/*  Resume a game from a save file, on the board it was saved on. The file
+    is mapped rather than read, and the snake uses the arrays in it where
+    they are, so loading costs a check of the header, of each segment and
+    of the board, and nothing is allocated for the arrays. Only the snake
+    itself, and on an unbounded board its chunks, come from the arena. The
+    mapping is let go of with close_save once the game is over. Returns
+    zero if the file couldn't be loaded, with errno set to say why. */
+int
+load_game (struct save_file *save, char *path, struct game_state *state,
+           struct game_data *game, struct arena *arena)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return 0;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return 0;
+  }
+  if (st.st_size < (off_t) sizeof (struct save_header)) {
+    close(fd);
+    errno = EINVAL;
+    return 0;
+  }
+  char *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return 0;
+  struct save_header *h = (struct save_header *) map;
+  if (!valid_header(h, st.st_size)) {
+    munmap(map, st.st_size);
+    errno = EINVAL;
+    return 0;
+  }
+
+  game->WALL_HT = h->board_ht;
+  game->WALL_WD = h->board_wd;
+  game->difficulty = h->difficulty;
+  game->unbounded = h->unbounded;
+
+  struct snake *snake = arena_alloc(arena, sizeof (struct snake));
+  snake->arena = arena;
+  snake->body = (struct point *) (map + h->body);
+  snake->capacity = h->capacity;
+  snake->head = h->head;
+  snake->length = h->length;
+  snake->board_wd = h->board_wd;
+  snake->words_per_row = h->words_per_row;
+  snake->occupied = h->occupied ? (unsigned char *) (map + h->occupied) : NULL;
+  snake->bits = h->bits ? (uint64_t *) (map + h->bits) : NULL;
+  snake->free_cells = h->free_cells ? (int *) (map + h->free_cells) : NULL;
+  snake->free_pos = h->free_pos ? (int *) (map + h->free_pos) : NULL;
+  snake->num_free = h->num_free;
+  snake->chunks = NULL;
+  if (h->unbounded) {
+    snake->chunks = arena_alloc(arena, sizeof (struct chunk_map));
+    init_chunk_map(snake->chunks, arena);
+    int i;
+    for (i=0; i<snake->length; i++) {
+      struct point p = snake_segment(snake, i);
+      chunk_add(snake->chunks, p.row, p.col);
+    }
+  }
+  if (!valid_body(snake, game) || !valid_board(snake, game)) {
+    munmap(map, st.st_size);
+    errno = EINVAL;
+    return 0;
+  }
+
+  state->game = game;
+  state->snake = snake;
+  state->food = h->food;
+  state->dir = h->dir;
+  state->ate_food = h->ate_food;
+  state->score = h->score;
+  state->ticks = h->ticks;
+  state->rng.state = h->rng;
+  save->map = map;
+  save->size = st.st_size;
+  return 1;
+}
+
+/*  Let go of the save file a game was resumed from, once nothing uses
+    its arrays. */
+void
+close_save (struct save_file *save)
+{
+  if (save->map != NULL) munmap(save->map, save->size);
+  save->map = NULL;
+}
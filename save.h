@@ -0,0 +1,82 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "game.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// what every save file starts with, and the version of the format
+#define SAVE_MAGIC "SNKS"
+#define SAVE_VERSION 1
+
+// what each part of a save file is aligned to
+#define SAVE_ALIGN 64
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// The start of a save file: everything about a game in progress that
+// isn't an array. The arrays the snake keeps follow it, each at an offset
+// from the start of the file, so nothing in the file is a pointer and it
+// can be used wherever it's mapped. An array the snake doesn't keep has
+// offset zero. Numbers are in the byte order of the machine that saved
+// the game, and header_size catches a header laid out differently.
+//
+// body is capacity points, the ring buffer as it was. On a bounded board
+// occupied is board_ht rows of board_wd bytes and bits is board_ht rows
+// of words_per_row words; free_cells and free_pos are the free set, if the
+// board is small enough to have one. An unbounded board keeps none of
+// them, and its chunks are made again from the body.
+struct save_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t pad;
+  uint64_t size;
+  int32_t board_ht;
+  int32_t board_wd;
+  int32_t difficulty;
+  int32_t unbounded;
+  int32_t dir;
+  int32_t ate_food;
+  int32_t score;
+  int32_t words_per_row;
+  int64_t ticks;
+  uint64_t rng;
+  struct point food;
+  int32_t capacity;
+  int32_t head;
+  int32_t length;
+  int32_t num_free;
+  uint64_t body;
+  uint64_t occupied;
+  uint64_t bits;
+  uint64_t free_cells;
+  uint64_t free_pos;
+};
+
+// A save file mapped into memory, which a game resumed from it uses in
+// place. The mapping is private, so the game's changes never reach the
+// file.
+struct save_file {
+  void *map;
+  size_t size;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+int save_game (struct game_state *state, char *path);
+int load_game (struct save_file *save, char *path, struct game_state *state,
+               struct game_data *game, struct arena *arena);
+void close_save (struct save_file *save);
+
+#endif
@@ -0,0 +1,737 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <dirent.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "autopilot.h"
+#include "draw.h"
+#include "game.h"
+#include "render.h"
+#include "replay.h"
+#include "sim.h"
+#include "snapshot.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// defaults for the headless command line
+#define DEFAULT_GAMES 1000
+#define DEFAULT_BOARD 20
+#define DEFAULT_MAX_TICKS 100000
+
+// most ticks a replay can say it ran for and still be played again to
+// check it, by default; a replay file is untrusted, and a snake going
+// straight on an unbounded board never dies
+#define DEFAULT_MAX_VERIFY_TICKS 20000000L
+
+// games played without a terminal are recorded as stepping at the speed
+// their difficulty would play at
+#define NS_PER_MS 1000000L
+
+// packing and unpacking a worker's range of games
+#define RANGE(LO,HI) (((uint64_t) (HI) << 32) | (uint64_t) (LO))
+#define RANGE_LO(R) ((long int) ((R) & 0xffffffff))
+#define RANGE_HI(R) ((long int) ((R) >> 32))
+
+
+
+// ------------------------------------------------------------
+// Policy functions.
+// ------------------------------------------------------------
+
+/*  Set up a policy. script may be NULL, in which case the policy makes
+    random moves using a generator seeded with seed. */
+void
+init_policy (struct policy *policy, char *script, uint64_t seed)
+{
+  policy->script = script;
+  policy->script_len = script == NULL ? 0 : strlen(script);
+  policy->at = 0;
+  policy->pilot = NULL;
+  seed_rng(&policy->rng, seed);
+}
+
+/*  Pick the direction the snake should try to go this step. */
+Direction
+policy_next (struct policy *policy, struct game_state *state)
+{
+
+  // Leave it to the autopilot, if there is one.
+  if (policy->pilot != NULL) return autopilot_next(policy->pilot, state);
+
+  // Follow the script, wrapping around when it runs out.
+  if (policy->script_len > 0) {
+    char c = policy->script[policy->at];
+    policy->at = (policy->at + 1) % policy->script_len;
+    switch (c) {
+      case 'N': return NORTH;
+      case 'E': return EAST;
+      case 'S': return SOUTH;
+      case 'W': return WEST;
+      default: return state->dir;
+    }
+  }
+
+  // Otherwise choose at random from the moves which don't run into the
+  // snake. Running into the wall leaves the head where it is, so that
+  // counts as running into the snake too.
+  Direction safe[4];
+  int num_safe = 0;
+  Direction d;
+  for (d=NORTH; d<=WEST; d++) {
+    if (opposites(state->dir, d)) continue;
+    struct point p = new_pos(state->game, state->snake, d);
+    if (!touching(state->snake, &p)) safe[num_safe++] = d;
+  }
+  if (num_safe == 0) return state->dir;
+  return safe[rng_below(&policy->rng, num_safe)];
+
+}
+
+
+
+// ------------------------------------------------------------
+// Simulation functions.
+// ------------------------------------------------------------
+
+/*  Play a game from the start until the snake dies, wins or has taken
+    max_ticks steps, leaving the game in state. If pilot is set, an
+    autopilot set up as it says plays rather than the script. If record is
+    set, the game is recorded into it, in the arena. The number of
+    autopilot moves which overran their budget goes in *overruns, if it's
+    set. */
+static Outcome
+play_until (struct arena *arena, struct game_data *game, uint64_t seed,
+            char *script, struct pilot_config *pilot_config, long int max_ticks,
+            struct game_state *state, struct replay *record, long int *overruns)
+{
+  struct policy policy;
+  struct autopilot pilot;
+  reset_arena(arena);
+  init_game(state, game, arena, seed);
+  init_policy(&policy, script, ~seed);
+  if (pilot_config != NULL) {
+    init_autopilot(&pilot, arena, game, pilot_config);
+    policy.pilot = &pilot;
+  }
+  if (record != NULL) init_replay(record, arena, game, seed, update_delay(game) * NS_PER_MS);
+
+  Outcome outcome = PLAYING;
+  while (outcome == PLAYING && state->ticks < max_ticks) {
+    Direction input = policy_next(&policy, state);
+    if (record != NULL && input != state->dir && !opposites(input, state->dir)) {
+      record_turn(record, state->ticks, input);
+    }
+    outcome = game_step(state, input);
+  }
+  if (record != NULL) end_replay(record, state, outcome);
+  if (overruns != NULL) *overruns = policy.pilot != NULL ? pilot.overruns : 0;
+  return outcome;
+}
+
+/*  Play a replay again from the start, by the same rules as any other
+    game, until it ends or the snake dies or wins, leaving the game in
+    state. game is set up as the board the replay was recorded on. */
+static Outcome
+play_replay (struct arena *arena, struct game_data *game, struct replay *replay,
+             struct game_state *state)
+{
+  reset_arena(arena);
+  memset(game, 0, sizeof *game);
+  replay_board(replay, game);
+  init_game(state, game, arena, replay->seed);
+  rewind_replay(replay);
+
+  Outcome outcome = PLAYING;
+  while (outcome == PLAYING && state->ticks < replay->ticks) {
+    outcome = game_step(state, replay_input(replay, state->ticks, state->dir));
+  }
+  return outcome;
+}
+
+/*  Fill in how a game ended. */
+static void
+get_result (struct game_state *state, Outcome outcome, struct game_result *result)
+{
+  result->outcome = outcome;
+  result->ticks = state->ticks;
+  result->score = state->score;
+  result->length = state->snake->length;
+  result->chunks = state->snake->chunks != NULL ? state->snake->chunks->peak : 0;
+  result->overruns = 0;
+}
+
+/*  Play one game without a terminal, as fast as possible, until the snake
+    dies, wins or has taken max_ticks steps. The game and the policy are
+    both seeded from seed, unless pilot is set and an autopilot plays it.
+    The arena is reset and reused for the game, so playing games one after
+    another doesn't touch the heap. */
+void
+play_headless (struct arena *arena, struct game_data *game, uint64_t seed,
+               char *script, struct pilot_config *pilot, long int max_ticks,
+               struct game_result *result)
+{
+  struct game_state state;
+  long int overruns;
+  Outcome outcome = play_until(arena, game, seed, script, pilot, max_ticks,
+                               &state, NULL, &overruns);
+  get_result(&state, outcome, result);
+  result->overruns = overruns;
+}
+
+/*  Play one game as play_headless does, recording it into a file in dir
+    named after its index. Returns zero if the file couldn't be written. */
+static int
+record_headless (struct arena *arena, struct game_data *game, uint64_t seed,
+                 char *script, struct pilot_config *pilot, long int max_ticks, char *dir,
+                 long int index, struct game_result *result)
+{
+  struct game_state state;
+  struct replay record;
+  long int overruns;
+  Outcome outcome = play_until(arena, game, seed, script, pilot, max_ticks,
+                               &state, &record, &overruns);
+  get_result(&state, outcome, result);
+  result->overruns = overruns;
+  char path[4096];
+  snprintf(path, sizeof path, "%s/%ld.rpl", dir, index);
+  return save_replay(&record, path);
+}
+
+/*  Play a replay file again and check that the game goes the way the file
+    says it did. A replay which says it ran for more than max_ticks isn't
+    played at all. */
+static void
+verify_file (struct arena *arena, char *path, long int max_ticks,
+             struct verdict *verdict)
+{
+  memset(verdict, 0, sizeof *verdict);
+  struct replay replay;
+  if (!open_replay(&replay, path)) {
+    verdict->reason = "not a replay";
+    return;
+  }
+  verdict->claimed.outcome = replay.outcome;
+  verdict->claimed.ticks = replay.ticks;
+  verdict->claimed.score = replay.score;
+  verdict->claimed.length = replay.length;
+  if (replay.ticks > max_ticks) {
+    verdict->reason = "too long";
+    close_replay(&replay);
+    return;
+  }
+
+  struct game_data game;
+  struct game_state state;
+  Outcome outcome = play_replay(arena, &game, &replay, &state);
+  get_result(&state, outcome, &verdict->result);
+  close_replay(&replay);
+
+  struct game_result *claimed = &verdict->claimed, *result = &verdict->result;
+  if (result->outcome != claimed->outcome) verdict->reason = "ended differently";
+  else if (result->ticks != claimed->ticks) verdict->reason = "wrong number of ticks";
+  else if (result->score != claimed->score) verdict->reason = "wrong score";
+  else if (result->length != claimed->length) verdict->reason = "wrong length";
+  else verdict->passed = 1;
+}
+
+/*  Play one game as play_headless does, then draw the board as it ended,
+    or the part of it around the head on an unbounded board, into a file,
+    as a frame buffer, so it can be compared with a frame known to be
+    right. Returns zero if the file couldn't be made. */
+static int
+write_frame (struct game_data *game, uint64_t seed, char *script,
+             struct pilot_config *pilot, long int max_ticks, char *path)
+{
+  struct arena arena;
+  struct game_state state;
+  init_arena(&arena, ARENA_BLOCK_SIZE);
+  Outcome outcome = play_until(&arena, game, seed, script, pilot, max_ticks,
+                               &state, NULL, NULL);
+
+  struct snapshot snap;
+  struct point corner = {0, 0};
+  init_snapshot(&snap, &arena, game);
+  struct point origin = follow_head(corner, &snap, snake_head(state.snake), game);
+  fill_snapshot(&snap, state.snake, state.food, origin);
+  snap.outcome = outcome;
+
+  struct backend backend;
+  struct frame_buffer frame;
+  int made = init_frame_backend(&backend, &frame, path, game->WALL_HT, game->WALL_WD);
+  if (made) {
+    struct damage damage = { .num_cells = 0, .full = 1 };
+    draw_damage(&damage, game, &snap, &backend);
+    backend.present(&backend);
+    backend.close(&backend);
+  }
+  free_arena(&arena);
+  return made;
+}
+
+/*  Get the time on the monotonic clock in seconds. */
+static double
+seconds (void)
+{
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return tp.tv_sec + tp.tv_nsec / 1e9;
+}
+
+/*  Take the next game from the front of a worker's own range. Returns its
+    index, or -1 if the worker has nothing left. */
+static long int
+take_game (struct worker *worker)
+{
+  uint64_t r = atomic_load(&worker->range);
+  while (RANGE_LO(r) < RANGE_HI(r)) {
+    uint64_t next = RANGE(RANGE_LO(r) + 1, RANGE_HI(r));
+    if (atomic_compare_exchange_weak(&worker->range, &r, next)) return RANGE_LO(r);
+  }
+  return -1;
+}
+
+/*  Steal the back half of another worker's games, rounding up so a lone
+    game can be stolen too. Returns zero if the victim had nothing left. */
+static int
+steal_games (struct worker *thief, struct worker *victim)
+{
+  uint64_t r = atomic_load(&victim->range);
+  while (RANGE_LO(r) < RANGE_HI(r)) {
+    long int lo = RANGE_LO(r), hi = RANGE_HI(r);
+    long int mid = lo + (hi - lo) / 2;
+    if (atomic_compare_exchange_weak(&victim->range, &r, RANGE(lo, mid))) {
+      atomic_store(&thief->range, RANGE(mid, hi));
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*  Add a game's result to a worker's running totals. */
+static void
+add_result (struct sim_results *results, struct game_result *result)
+{
+  results->games++;
+  results->ticks += result->ticks;
+  results->score += result->score;
+  results->length += result->length;
+  if (result->outcome == WON) results->won++;
+  if (result->score > results->max_score) results->max_score = result->score;
+  if (result->chunks > results->max_chunks) results->max_chunks = result->chunks;
+  results->overruns += result->overruns;
+}
+
+/*  Raise a shared maximum to a value, if it's bigger. */
+static void
+raise_max (_Atomic long int *max, long int value)
+{
+  long int was = atomic_load(max);
+  while (value > was && !atomic_compare_exchange_weak(max, &was, value));
+}
+
+/*  Thread body. Plays games from the worker's own range, and when that
+    runs dry steals from the others, until there is nothing left anywhere.
+    Game i is always seeded with seed + i, or is the replay in file i, so
+    the results don't depend on which thread ends up playing it. A replay
+    counts towards the totals only if it checks out. */
+static void *
+work (void *arg)
+{
+  struct worker *self = arg;
+  struct batch *batch = self->batch;
+  memset(&self->results, 0, sizeof self->results);
+
+  while (1) {
+    long int i = take_game(self);
+    if (i < 0) {
+      int j, stole = 0;
+      for (j=1; j<batch->num_workers && !stole; j++) {
+        struct worker *victim = &batch->workers[(self->id + j) % batch->num_workers];
+        stole = steal_games(self, victim);
+      }
+      if (!stole) break;
+      continue;
+    }
+
+    struct game_result result;
+    if (batch->files != NULL) {
+      struct verdict *verdict = &batch->verdicts[i];
+      verify_file(&self->arena, batch->files[i], batch->max_ticks, verdict);
+      if (verdict->passed) add_result(&self->results, &verdict->result);
+    }
+    else if (batch->record_dir != NULL) {
+      if (!record_headless(&self->arena, batch->game, batch->seed + i, batch->script,
+                           batch->pilot, batch->max_ticks, batch->record_dir,
+                           i, &result)) {
+        self->results.unsaved++;
+      }
+      add_result(&self->results, &result);
+    }
+    else {
+      play_headless(&self->arena, batch->game, batch->seed + i, batch->script,
+                    batch->pilot, batch->max_ticks, &result);
+      add_result(&self->results, &result);
+    }
+  }
+
+  // Fold this worker's totals into the batch's.
+  struct sim_results *r = &self->results;
+  atomic_fetch_add(&batch->games, r->games);
+  atomic_fetch_add(&batch->ticks, r->ticks);
+  atomic_fetch_add(&batch->score, r->score);
+  atomic_fetch_add(&batch->length, r->length);
+  atomic_fetch_add(&batch->won, r->won);
+  raise_max(&batch->max_score, r->max_score);
+  raise_max(&batch->max_chunks, r->max_chunks);
+  atomic_fetch_add(&batch->overruns, r->overruns);
+  atomic_fetch_add(&batch->unsaved, r->unsaved);
+  return NULL;
+}
+
+/*  Play the games of a batch spread over a number of threads, and total
+    up how they went. Games start out split evenly between the threads. */
+static void
+run_pool (struct batch *batch, long int games, int threads,
+          struct sim_results *results)
+{
+  batch->num_workers = threads;
+  batch->workers = aligned_alloc(64, threads * sizeof (struct worker));
+  atomic_init(&batch->games, 0);
+  atomic_init(&batch->ticks, 0);
+  atomic_init(&batch->score, 0);
+  atomic_init(&batch->length, 0);
+  atomic_init(&batch->won, 0);
+  atomic_init(&batch->max_score, 0);
+  atomic_init(&batch->max_chunks, 0);
+  atomic_init(&batch->overruns, 0);
+  atomic_init(&batch->unsaved, 0);
+
+  int i;
+  for (i=0; i<threads; i++) {
+    struct worker *worker = &batch->workers[i];
+    worker->id = i;
+    worker->batch = batch;
+    init_arena(&worker->arena, ARENA_BLOCK_SIZE);
+    atomic_init(&worker->range, RANGE(games * i / threads, games * (i+1) / threads));
+  }
+
+  // The calling thread does the work of the first worker.
+  double start = seconds();
+  for (i=1; i<threads; i++) {
+    pthread_create(&batch->workers[i].thread, NULL, work, &batch->workers[i]);
+  }
+  work(&batch->workers[0]);
+  for (i=1; i<threads; i++) pthread_join(batch->workers[i].thread, NULL);
+  results->seconds = seconds() - start;
+
+  results->games = atomic_load(&batch->games);
+  results->ticks = atomic_load(&batch->ticks);
+  results->score = atomic_load(&batch->score);
+  results->length = atomic_load(&batch->length);
+  results->won = atomic_load(&batch->won);
+  results->max_score = atomic_load(&batch->max_score);
+  results->max_chunks = atomic_load(&batch->max_chunks);
+  results->overruns = atomic_load(&batch->overruns);
+  results->unsaved = atomic_load(&batch->unsaved);
+  for (i=0; i<threads; i++) free_arena(&batch->workers[i].arena);
+  free(batch->workers);
+}
+
+/*  Play a batch of games spread over a number of threads, and total up how
+    they went. If pilot is set, an autopilot set up as it says plays every
+    game. If record_dir is set, each game is saved into it as a replay. */
+void
+run_batch (struct game_data *game, uint64_t seed, char *script,
+           struct pilot_config *pilot, long int max_ticks, long int games, int threads,
+           char *record_dir, struct sim_results *results)
+{
+  struct batch batch;
+  batch.game = game;
+  batch.seed = seed;
+  batch.script = script;
+  batch.pilot = pilot;
+  batch.max_ticks = max_ticks;
+  batch.record_dir = record_dir;
+  batch.files = NULL;
+  batch.verdicts = NULL;
+  run_pool(&batch, games, threads, results);
+}
+
+/*  Play replay files again spread over a number of threads, with how each
+    went going in verdicts, and total up the games which checked out. Any
+    replay longer than max_ticks fails without being played. */
+void
+verify_replays (char **files, long int num_files, int threads, long int max_ticks,
+                struct verdict *verdicts, struct sim_results *results)
+{
+  struct batch batch;
+  batch.game = NULL;
+  batch.seed = 0;
+  batch.script = NULL;
+  batch.pilot = NULL;
+  batch.max_ticks = max_ticks;
+  batch.record_dir = NULL;
+  batch.files = files;
+  batch.verdicts = verdicts;
+  run_pool(&batch, num_files, threads, results);
+}
+
+/*  Print how a batch of games went, and if an autopilot played them, how
+    many of its moves overran their budget. */
+static void
+print_results (struct sim_results *results, struct pilot_config *pilot)
+{
+  printf("games: %ld\n", results->games);
+  printf("ticks: %ld\n", results->ticks);
+  printf("won: %ld\n", results->won);
+  printf("mean score: %.2f\n", (double) results->score / results->games);
+  printf("max score: %ld\n", results->max_score);
+  printf("mean length: %.2f\n", (double) results->length / results->games);
+  if (results->max_chunks > 0) printf("peak chunks: %ld\n", results->max_chunks);
+  if (pilot != NULL) printf("autopilot overruns: %ld\n", results->overruns);
+  printf("seconds: %.3f\n", results->seconds);
+  printf("games/sec: %.0f\n", results->games / results->seconds);
+  printf("ticks/sec: %.0f\n", results->ticks / results->seconds);
+}
+
+/*  Play the same batch with 1, 2, 4, ... threads up to the given number,
+    and print how well it scales. */
+static void
+print_scaling (struct game_data *game, uint64_t seed, char *script,
+               struct pilot_config *pilot, long int max_ticks, long int games,
+               int threads)
+{
+  printf("%8s %14s %14s %9s %11s\n",
+         "threads", "games/sec", "ticks/sec", "speedup", "efficiency");
+  double base = 0;
+  int t = 1;
+  while (1) {
+    struct sim_results results;
+    run_batch(game, seed, script, pilot, max_ticks, games, t, NULL, &results);
+    double rate = results.ticks / results.seconds;
+    if (t == 1) base = rate;
+    printf("%8d %14.0f %14.0f %8.2fx %10.0f%%\n", t,
+           results.games / results.seconds, rate, rate / base,
+           100 * rate / base / t);
+    if (t == threads) break;
+    t = t * 2 > threads ? threads : t * 2;
+  }
+}
+
+/*  Compare two file names, for qsort. */
+static int
+compare_names (const void *a, const void *b)
+{
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/*  Play every replay file in a directory again, spread over a number of
+    threads, and print whether each one checks out, in order of name, then
+    how fast they went. Replays longer than max_ticks fail. Returns the
+    exit status, which is zero only if every replay checked out. */
+static int
+verify_dir (char *dir, int threads, long int max_ticks)
+{
+  DIR *d = opendir(dir);
+  if (d == NULL) {
+    perror(dir);
+    return 1;
+  }
+  long int num_files = 0, room = 64;
+  char **files = malloc(room * sizeof (char *));
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    if (entry->d_name[0] == '.' || entry->d_type == DT_DIR) continue;
+    if (num_files == room) {
+      room *= 2;
+      files = realloc(files, room * sizeof (char *));
+    }
+    size_t len = strlen(dir) + strlen(entry->d_name) + 2;
+    files[num_files] = malloc(len);
+    snprintf(files[num_files++], len, "%s/%s", dir, entry->d_name);
+  }
+  closedir(d);
+  qsort(files, num_files, sizeof (char *), compare_names);
+
+  struct verdict *verdicts = malloc(num_files * sizeof (struct verdict));
+  struct sim_results results;
+  verify_replays(files, num_files, threads, max_ticks, verdicts, &results);
+
+  long int i, failed = 0;
+  for (i=0; i<num_files; i++) {
+    struct verdict *v = &verdicts[i];
+    struct game_result *claimed = &v->claimed, *result = &v->result;
+    if (v->passed) {
+      printf("PASS %s: score %d, length %d, %ld ticks\n",
+             files[i], result->score, result->length, result->ticks);
+    }
+    else if (claimed->ticks == 0 && result->ticks == 0) {
+      printf("FAIL %s: %s\n", files[i], v->reason);
+    }
+    else if (claimed->ticks > max_ticks) {
+      printf("FAIL %s: %s (claimed %ld ticks, at most %ld are checked)\n",
+             files[i], v->reason, claimed->ticks, max_ticks);
+    }
+    else {
+      printf("FAIL %s: %s (claimed score %d, length %d, %ld ticks; "
+             "got score %d, length %d, %ld ticks)\n",
+             files[i], v->reason, claimed->score, claimed->length, claimed->ticks,
+             result->score, result->length, result->ticks);
+    }
+    if (!v->passed) failed++;
+    free(files[i]);
+  }
+  printf("replays: %ld\n", num_files);
+  printf("passed: %ld\n", num_files - failed);
+  printf("failed: %ld\n", failed);
+  printf("ticks: %ld\n", results.ticks);
+  printf("seconds: %.3f\n", results.seconds);
+  printf("ticks/ms: %.0f\n", results.ticks / results.seconds / 1000);
+  free(verdicts);
+  free(files);
+  return failed > 0;
+}
+
+static void
+usage (char *prog)
+{
+  fprintf(stderr,
+    "usage: %s --headless [--games N] [--seed S] [--width W] [--height H]\n"
+    "       [--max-ticks T] [--script DIRS] [--threads N] [--scaling]\n"
+    "       [--unbounded] [--frame FILE] [--record DIR] [--autopilot]\n"
+    "       [--autopilot-us US] [--autopilot-cycle]\n"
+    "       %s --verify DIR [--threads N] [--max-ticks T]\n"
+    "--autopilot-us gives the autopilot US microseconds for each move\n"
+    "(default %d). A move that takes longer is an overrun: its search was\n"
+    "cut short, and the snake moved on the best it had found so far.\n",
+    prog, prog, DEFAULT_AUTOPILOT_US);
+}
+
+/*  Entry point for "snake --headless". Plays a batch of games with no
+    terminal and reports how fast they ran, saving each as a replay with
+    --record, or with --frame draws how the first game of the batch ended.
+    Also the entry point for "snake --verify", which plays replays again
+    to check them. Returns the exit status. */
+int
+headless_main (int argc, char *argv[])
+{
+  struct option options[] = {
+    { "headless", no_argument, NULL, 'h' },
+    { "games", required_argument, NULL, 'g' },
+    { "seed", required_argument, NULL, 's' },
+    { "width", required_argument, NULL, 'w' },
+    { "height", required_argument, NULL, 'H' },
+    { "max-ticks", required_argument, NULL, 't' },
+    { "script", required_argument, NULL, 'S' },
+    { "threads", required_argument, NULL, 'T' },
+    { "scaling", no_argument, NULL, 'x' },
+    { "frame", required_argument, NULL, 'f' },
+    { "unbounded", no_argument, NULL, 'u' },
+    { "record", required_argument, NULL, 'r' },
+    { "verify", required_argument, NULL, 'v' },
+    { "autopilot", no_argument, NULL, 'a' },
+    { "autopilot-us", required_argument, NULL, 'b' },
+    { "autopilot-cycle", no_argument, NULL, 'c' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  long int games = DEFAULT_GAMES;
+  uint64_t seed = time(NULL);
+  long int max_ticks = -1;
+  char *script = NULL;
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int scaling = 0;
+  char *frame_file = NULL;
+  char *record_dir = NULL;
+  char *verify = NULL;
+  int autopilot = 0;
+  struct pilot_config pilot = { DEFAULT_AUTOPILOT_US, 0 };
+  struct game_data game = { .WALL_HT = DEFAULT_BOARD, .WALL_WD = DEFAULT_BOARD };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (opt) {
+      case 'h': break;
+      case 'g': games = atol(optarg); break;
+      case 's': seed = strtoull(optarg, NULL, 10); break;
+      case 'w': game.WALL_WD = atoi(optarg); break;
+      case 'H': game.WALL_HT = atoi(optarg); break;
+      case 't': max_ticks = atol(optarg); break;
+      case 'S': script = optarg; break;
+      case 'T': threads = atoi(optarg); break;
+      case 'x': scaling = 1; break;
+      case 'f': frame_file = optarg; break;
+      case 'u': game.unbounded = 1; break;
+      case 'r': record_dir = optarg; break;
+      case 'v': verify = optarg; break;
+      case 'a': autopilot = 1; break;
+      case 'b': pilot.budget_us = atoi(optarg); break;
+      case 'c': autopilot = pilot.cycle = 1; break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (threads < 1) threads = 1;
+  if (verify != NULL) {
+    return verify_dir(verify, threads, max_ticks >= 0 ? max_ticks : DEFAULT_MAX_VERIFY_TICKS);
+  }
+  if (max_ticks < 0) max_ticks = DEFAULT_MAX_TICKS;
+  if (pilot.budget_us < 1) pilot.budget_us = 1;
+  struct pilot_config *pilot_config = autopilot ? &pilot : NULL;
+  if (games <= 0 || games > 0xffffffffL) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (game.WALL_WD < MIN_BOARD || game.WALL_WD > MAX_BOARD ||
+      game.WALL_HT < MIN_BOARD || game.WALL_HT > MAX_BOARD) {
+    fprintf(stderr, "%s: the board must be from %d to %d cells across and down\n",
+            argv[0], MIN_BOARD, MAX_BOARD);
+    return 1;
+  }
+
+  // Games can only be recorded into a directory which can be written to.
+  struct stat st;
+  if (record_dir != NULL && (stat(record_dir, &st) != 0 || access(record_dir, W_OK) != 0)) {
+    perror(record_dir);
+    return 1;
+  }
+  if (record_dir != NULL && !S_ISDIR(st.st_mode)) {
+    fprintf(stderr, "%s: not a directory\n", record_dir);
+    return 1;
+  }
+
+  // Each game gets its own seed, so any one of them can be played again,
+  // and its last frame drawn.
+  if (frame_file != NULL) {
+    if (write_frame(&game, seed, script, pilot_config, max_ticks, frame_file)) return 0;
+    perror(frame_file);
+    return 1;
+  }
+  if (scaling) {
+    print_scaling(&game, seed, script, pilot_config, max_ticks, games, threads);
+    return 0;
+  }
+  struct sim_results results;
+  run_batch(&game, seed, script, pilot_config, max_ticks, games, threads,
+            record_dir, &results);
+  print_results(&results, pilot_config);
+  if (results.unsaved > 0) {
+    fprintf(stderr, "%s: could not save %ld replays\n", record_dir, results.unsaved);
+    return 1;
+  }
+  return 0;
+}
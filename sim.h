@@ -0,0 +1,124 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "arena.h"
+#include "autopilot.h"
+#include "game.h"
+#include "replay.h"
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// Decides which way a simulated snake should go each step. If script is
+// set, the snake follows its directions (one of "NESW" per step) over and
+// over. Otherwise it picks at random between the moves which don't
+// immediately kill it. If pilot is set, it decides instead of either.
+struct policy {
+  char *script;
+  int script_len;
+  int at;
+  struct rng rng;
+  struct autopilot *pilot;
+};
+
+// How a simulated game ended. On an unbounded board, chunks is the most
+// chunks of it which were resident at once. If an autopilot played it,
+// overruns is how many of its moves took longer than their budget.
+struct game_result {
+  Outcome outcome;
+  long int ticks;
+  int score;
+  int length;
+  int chunks;
+  long int overruns;
+};
+
+// Whether a replay checked out when it was played again. claimed is how
+// the replay says the game went, and result how it actually went; if they
+// differ, or the file couldn't be read, reason says why.
+struct verdict {
+  int passed;
+  char *reason;
+  struct game_result claimed;
+  struct game_result result;
+};
+
+// How a batch of simulated games went. unsaved is how many of the games
+// being recorded couldn't be written out.
+struct sim_results {
+  long int games;
+  long int ticks;
+  long int score;
+  long int length;
+  long int won;
+  long int max_score;
+  long int max_chunks;
+  long int overruns;
+  long int unsaved;
+  double seconds;
+};
+
+// A thread playing its share of a batch. The games it has left to play
+// are the indices [lo, hi), packed into one word as hi << 32 | lo so that
+// other threads can steal half of them with a single compare-and-swap.
+// Each worker sits on its own cache line so that they don't slow each
+// other down.
+struct worker {
+  _Alignas(64) _Atomic uint64_t range;
+  pthread_t thread;
+  int id;
+  struct batch *batch;
+  struct sim_results results;
+  struct arena arena;
+};
+
+// A batch of games being played by a pool of workers. Workers add their
+// results to the totals when they finish, without taking a lock. If
+// pilot is set, an autopilot set up as it says plays the games rather
+// than the script. If record_dir is set, each game is saved into it as
+// a replay. If files is set, game i is instead playing the replay in
+// files[i] again, and how that went goes in verdicts[i].
+struct batch {
+  struct game_data *game;
+  uint64_t seed;
+  char *script;
+  struct pilot_config *pilot;
+  long int max_ticks;
+  char *record_dir;
+  char **files;
+  struct verdict *verdicts;
+  struct worker *workers;
+  int num_workers;
+  _Atomic long int games;
+  _Atomic long int ticks;
+  _Atomic long int score;
+  _Atomic long int length;
+  _Atomic long int won;
+  _Atomic long int max_score;
+  _Atomic long int max_chunks;
+  _Atomic long int overruns;
+  _Atomic long int unsaved;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+void init_policy (struct policy *policy, char *script, uint64_t seed);
+Direction policy_next (struct policy *policy, struct game_state *state);
+void play_headless (struct arena *arena, struct game_data *game, uint64_t seed,
+                    char *script, struct pilot_config *pilot, long int max_ticks,
+                    struct game_result *result);
+void run_batch (struct game_data *game, uint64_t seed, char *script,
+                struct pilot_config *pilot, long int max_ticks, long int games,
+                int threads,
+                char *record_dir, struct sim_results *results);
+void verify_replays (char **files, long int num_files, int threads, long int max_ticks,
+                     struct verdict *verdicts, struct sim_results *results);
+int headless_main (int argc, char *argv[]);
+
+#endif
@@ -1,31 +1,67 @@
-
+#define _GNU_SOURCE
 
 // ------------------------------------------------------------
 // Imports.
 // ------------------------------------------------------------
 
+#include <fcntl.h>
 #include <ncurses.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <string.h>
-#include <sys/time.h>
-
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "autopilot.h"
+#include "draw.h"
+#include "game.h"
+#include "input.h"
 #include "menu.h"
+#include "metrics.h"
+#include "render.h"
+#include "replay.h"
+#include "save.h"
+#include "sim.h"
+#include "snapshot.h"
 
 // ------------------------------------------------------------
 // Macros.
 // ------------------------------------------------------------
 
-// colour pairs used in drawing
-#define COLOR_SNAKE COLOR_PAIR(1)
-#define COLOR_WALL COLOR_PAIR(2)
-#define COLOR_FOOD COLOR_PAIR(3)
-
 // key constants
 #define KEY_ESC 27
 
-#define MAX(X,Y) X>Y?X:Y
-#define MIN(X,Y) X<Y?X:Y
+// how long ncurses waits after an escape, in the menu, to see if it
+// starts a sequence
+#define MENU_ESCDELAY 25
+
+// units of time on the monotonic clock
+#define NS_PER_MS 1000000L
+#define NS_PER_SEC 1000000000L
+
+// limits and defaults for the step and frame rates
+#define MAX_SIM_HZ 1000
+#define MAX_RENDER_HZ 240
+#define DEFAULT_RENDER_HZ 60
+
+// how far steps can fall behind before the missed ones are given up on
+#define MAX_STEP_LAG (250 * NS_PER_MS)
+
+// bytes waiting to go to the terminal past which frames are skipped
+#define DEFAULT_MAX_BACKLOG 1024
+
+// where a quit game is saved by default, in the home directory
+#define SAVE_FILE_NAME ".snake-save"
+
+// sides of the board by default, and the smallest view of it
+#define DEFAULT_BOARD 20
+#define MIN_VIEW 8
 
 
 
@@ -33,391 +69,623 @@
 // Typedefs, enums.
 // ------------------------------------------------------------
 
-// Represents the direction of the snake.
-typedef enum {NORTH, EAST, SOUTH, WEST} Direction;
-
-// Each piece of the snake is the element of a linked list.
-struct snake {
-  struct point *loc; // This could be made better by eliminating the indirection.
-  struct snake *next;
+// A game being played on one thread and drawn on another. The drawing
+// thread reads the keys and queues turns; the playing thread takes them
+// off the queue, owns the game state, and publishes a snapshot of the
+// board for the drawing thread after it steps. camera is where the view
+// of the board in the snapshots starts, which follows the snake's head.
+// minimap is the board shrunk down, worked out again with kernel at most
+// once a minimap_period, and handed on with every snapshot. If replay is
+// set the turns come from it rather than the player, and the game stops
+// where the replay does; if pilot is set the autopilot makes them. If
+// record is set the turns made go into it. outcome is how the game stood
+// when the playing thread stopped.
+struct game_thread {
+  struct game_data *game;
+  struct game_state state;
+  struct replay *replay;
+  struct autopilot *pilot;
+  struct replay *record;
+  Outcome outcome;
+  struct point camera;
+  struct minimap minimap;
+  struct popcount_kernel *kernel;
+  uint64_t *minimap_counts;
+  int64_t minimap_period;
+  struct turn_queue turns;
+  struct triple_buffer frames;
+  int64_t step_period;
+  _Atomic int quit;
+  int wake[2];
+  int ready[2];
+  pthread_t thread;
 };
 
-struct point {
-  int row;
-  int col;
-};
 
-struct game_data {
-  int rows;
-  int cols;
-  int WALL_HT;
-  int WALL_WD;
-  int difficulty;
-};
 
 // ------------------------------------------------------------
-// Function declarations.
+// Globals.
 // ------------------------------------------------------------
 
-// Drawing functions.
-void draw_snake (struct snake *, WINDOW *);
-void draw_wall (struct game_data *, WINDOW *);
-void draw_food (struct point, WINDOW *);
-void draw_direction (Direction, WINDOW *);
+// set by the SIGWINCH handler while a game is running
+static volatile sig_atomic_t window_changed = 0;
 
-// Snake-related functions.
-struct snake *init_snake (struct snake *prev, int row, int col);
-struct point new_pos (struct game_data *, struct snake *, Direction dir);
-void move_snake (struct game_data *game, struct snake *head, struct point);
-void grow_snake (struct game_data *game, struct snake **head, struct point);
-int touching (struct snake *head, struct point *p);
-int opposites (Direction d1, Direction d2);
+// how many turns the player can get ahead of the snake
+static int turn_depth = DEFAULT_TURN_DEPTH;
 
-// Food-related functions.
-struct point randomise_food (struct game_data *game, struct snake *head);
+// steps a second, or 0 to go at the difficulty's speed; frames a second
+static int sim_hz = 0;
+static int render_hz = DEFAULT_RENDER_HZ;
 
-// Time-related functions.
-long int timems (void);
-long int update_delay(struct game_data *);
+// how far behind the terminal can get before frames are skipped
+static int max_backlog = DEFAULT_MAX_BACKLOG;
 
-// Input-related functions.
-int process_input(Direction snake_dir, Direction *queued_dir);
+// how many rows and columns the board has, walls included, unless it
+// goes on forever
+static int board_ht = DEFAULT_BOARD;
+static int board_wd = DEFAULT_BOARD;
+static int unbounded = 0;
 
-// Game-related functions.
-void play_game (struct game_data *, WINDOW *);
+// what games are drawn with: "curses", "ansi", "null" or "frame"; and the
+// file the frame backend draws into, if not memory
+static char *backend_name = "curses";
+static char *frame_file = NULL;
 
+// the replay being played back instead of a game, if there is one, and
+// how many times faster than it was played, or 0 to go straight to the
+// end; the file every game is recorded into, if any, and whether writing
+// it failed
+static struct replay *replay = NULL;
+static int replay_speed = 1;
+static char *record_file = NULL;
+static int record_failed = 0;
+
+// where a game the player quits is saved, to be resumed from the menu,
+// and whether saving it failed
+static char *save_path = NULL;
+static int save_failed = 0;
+
+// whether the snake plays itself, and how
+static int autopilot = 0;
+static struct pilot_config pilot_config = { DEFAULT_AUTOPILOT_US, 0 };
 
 
 // ------------------------------------------------------------
-// Time functions.
+// Function declarations.
 // ------------------------------------------------------------
 
-/*  Get the number of time elapsed since the epoch in
-    milliseconds. */
-long int timems (void)
-{
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  return tp.tv_sec * 1000 + tp.tv_usec / 1000;
-}
+// Output-related functions.
+int output_backlogged (int fd, int threshold);
 
-/*  Get the amount of time to wait between steps of the game world. This should
-    increase with difficulty. */
-long int update_delay (struct game_data *game) {
-  long int delay = 300 - 20*game->difficulty;
-  if (delay < 20) return 20;
-  return delay;
-}
+// Time-related functions.
+void wait_readable (int fd, int other_fd, int64_t deadline);
+
+// Input-related functions.
+int process_input(struct input_decoder *decoder, struct turn_queue *turns,
+                  int *resized);
+
+// Game-related functions.
+void play_game (struct game_data *, WINDOW *, int resume);
 
 
 
 // ------------------------------------------------------------
-// Drawing functions.
+// Time functions.
 // ------------------------------------------------------------
 
-/*  Draw the snake on the default ncurses window. */
-void draw_snake (struct snake *snake, WINDOW *window)
+/*  Sleep until there is something to read on either file descriptor or
+    the monotonic clock, as read by timens, reaches the deadline, whichever
+    comes first. A negative descriptor is ignored, and a deadline of -1
+    never comes. Unlike the time of day this clock never jumps, so steps
+    can be scheduled against it, and ppoll sleeps to the nanosecond rather
+    than the millisecond, which matters at a thousand steps a second. */
+void wait_readable (int fd, int other_fd, int64_t deadline)
 {
-  wattron(window, COLOR_SNAKE);
-  while (snake != NULL) {
-    mvwaddch(window, snake->loc->row, snake->loc->col, '*');
-    snake = snake->next;
+  struct timespec ts;
+  if (deadline >= 0) {
+    int64_t wait = deadline - timens();
+    if (wait <= 0) return;
+    ts.tv_sec = wait / NS_PER_SEC;
+    ts.tv_nsec = wait % NS_PER_SEC;
   }
-  wattroff(window, COLOR_SNAKE);
+  struct pollfd pfds[2] = { { fd, POLLIN, 0 }, { other_fd, POLLIN, 0 } };
+  ppoll(pfds, 2, deadline >= 0 ? &ts : NULL, NULL);
 }
 
-void draw_food (struct point pt, WINDOW *window)
-{
-  wattron(window, COLOR_FOOD);
-  mvwaddch(window, pt.row, pt.col, '*');
-  wattroff(window, COLOR_FOOD);
-}
 
-/*  Draw the wall on the default ncurses window. */
-void draw_wall (struct game_data *game, WINDOW *window)
-{
-  wattron(window, COLOR_WALL);
-  int i;
 
-  // draw the left and right edges
-  for (i=0; i< game->WALL_WD; i++) {
-    mvwaddch(window, 0, i, '*');
-    mvwaddch(window, game->WALL_HT-1, i, '*');
-  }
+// ------------------------------------------------------------
+// Output functions.
+// ------------------------------------------------------------
 
-  // draw top and bottom edges
-  for (i=1; i<game->WALL_HT-1; i++) {
-    mvwaddch(window, i, 0, '*');
-    mvwaddch(window, i, game->WALL_WD-1, '*');
-  }
+// Every write the process makes, including those ncurses makes to send a
+// refresh, goes through this wrapper, which counts what goes to the
+// terminal for the curses backend.
+extern ssize_t __write (int fd, const void *buf, size_t count);
 
-  wattroff(window, COLOR_WALL);
+ssize_t write (int fd, const void *buf, size_t count)
+{
+  ssize_t n = __write(fd, buf, count);
+  if (n > 0 && fd == STDOUT_FILENO) terminal_bytes += n;
+  return n;
 }
 
-/*  Draw the queued direction of the snake. */
-void draw_direction (Direction queued_dir, WINDOW *window)
+/*  Check whether the terminal is behind with what has been sent to it:
+    more than threshold bytes are still queued to go out, or there is no
+    room to write any more without blocking. A pty always says nothing is
+    queued, so over ssh, or on a local pty, only the second can tell. */
+int output_backlogged (int fd, int threshold)
 {
-    char c;
-    switch (queued_dir) {
-      case NORTH:
-        c = 'N';
-        break;
-      case SOUTH:
-        c = 'S';
-        break;
-      case WEST:
-        c = 'W';
-        break;
-      case EAST:
-        c = 'E';
-        break;
-    }
-    mvwaddch(window, 2, 45, c);
+  int queued;
+  if (ioctl(fd, TIOCOUTQ, &queued) == 0 && queued > threshold) return 1;
+  struct pollfd pfd = { fd, POLLOUT, 0 };
+  return poll(&pfd, 1, 0) == 0;
 }
 
 
 
 // ------------------------------------------------------------
-// Snake functions.
+// Input functions.
 // ------------------------------------------------------------
 
-/*  Create and allocate a segment of snake at the specified (row,col)
-    position. If next is specified, then that will be the next pointer
-    in the initialised segment of snake. */
-struct snake *init_snake (struct snake *next, int row, int col)
+/*  Note that the terminal changed size. The game reads the terminal
+    itself rather than through getch, so ncurses never gets to. */
+static void on_window_change (int sig)
 {
-  struct snake *snake = malloc(sizeof (struct snake));
-  struct point *p = malloc(sizeof (struct point));
-  p->row = row; p->col = col;
-  snake->loc = p;
-  snake->next = next;
-  return snake;
+  window_changed = 1;
 }
 
-void
-del_snake (struct snake *head, int recursive)
+/*  Process user input. Queues a turn for each arrow key the user has
+    pressed, reading every key that is waiting. Sets resized if the
+    terminal changed size. Will return a non-zero value if the program
+    should terminate. Otherwise it will return zero. */
+int process_input(struct input_decoder *decoder, struct turn_queue *turns,
+                  int *resized)
 {
+    struct input_event events[MAX_INPUT_EVENTS];
+    int num_events = read_input(decoder, STDIN_FILENO, events, MAX_INPUT_EVENTS);
+
+    // check if the terminal changed size
+    if (window_changed) {
+      window_changed = 0;
+      struct winsize ws;
+      if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) resizeterm(ws.ws_row, ws.ws_col);
+      *resized = 1;
+    }
 
-  if (!recursive) {
-    free(head->loc);
-    free(head);
-    return;  
-  }
-
-  struct snake *next;
-  while (head != NULL) {
-    next = head->next;
-    free(head->loc);
-    free(head);
-    head = next;
-  }
-
-}
+    int i;
+    for (i=0; i<num_events; i++) {
 
+      // check if user pushed escape
+      if (events[i].key == INPUT_ESC) return 1;
 
+      // get direction the user pushed
+      Direction d2;
+      if (events[i].key == INPUT_UP) d2 = NORTH;
+      else if (events[i].key == INPUT_DOWN) d2 = SOUTH;
+      else if (events[i].key == INPUT_LEFT) d2 = WEST;
+      else d2 = EAST;
 
-/*  Check to see if the body of the snake is touching the specified
-    row and col. */
-int touching (struct snake *head, struct point *p)
-{
-  while (head != NULL) {
-    if (head->loc->row == p->row && head->loc->col == p->col) return 1;
-    head = head->next;
-  }
-  return 0;
+      // queue the turn, if snake can turn in that direction
+      push_turn(turns, d2, events[i].time);
+    }
+    return 0;
 }
 
-/*  Prepend a new head to the snake. Update the pointer to the head of the
-    snake. */
-void
-grow_snake (struct game_data *game, struct snake **snake, struct point newpos)
+/*  Check whether a game being played back has reached the end of its
+    replay. */
+static inline int replay_over (struct game_thread *play)
 {
-
-  // figure out where the snake should now be.
-  struct snake *head = *snake;
-  int newRow = newpos.row;
-  int newCol = newpos.col;
-
-  // If the snake has grown, prepend the new segment to the head of the snake.
-  struct snake *new_head = init_snake(head, newRow, newCol);
-  *snake = new_head;
-  
-}
-
-/*  Move the snake one step in the specified direction. Returns a non-zero
-    value if the snake moved successfully without touching itself or a wall.
-    Otherwise returns zero.  */
-void
-move_snake (struct game_data *game, struct snake *head, struct point newpos) {
-  
-  int newRow = newpos.row;
-  int newCol = newpos.col;
-  
-  // Shift each segment of the snake along one.
-  int currRow, currCol;
-  while (head != NULL) {
-    currRow = head->loc->row;
-    currCol = head->loc->col;
-    head->loc->row = newRow;
-    head->loc->col = newCol;
-    newRow = currRow;
-    newCol = currCol;
-    head = head->next;
-  }
-
+  return play->replay != NULL && play->state.ticks >= play->replay->ticks;
 }
 
-struct point
-new_pos (struct game_data *game, struct snake *head, Direction dir)
+/*  Thread body for playing a game. Makes each step when it is due, and
+    publishes a snapshot after the steps made on each wakeup. Nothing here
+    waits on the terminal, so the steps keep to time however slowly frames
+    are drawn. Stops when the game is over or the drawing thread asks it
+    to. */
+static void *simulate (void *arg)
 {
-  
-  // Figure out where the snake should now be.
-  int newRow = head->loc->row;
-  int newCol = head->loc->col;
-  switch (dir) {
-    case NORTH:
-      newRow = MAX(head->loc->row-1, 1);
-      break;
+  struct game_thread *play = arg;
+  struct game_state *state = &play->state;
+  struct snake *snake = state->snake;
+  int64_t stepPeriod = play->step_period;
+
+  // Step n is due n step periods after the epoch, so however long the
+  // game goes on, rounding never adds up to a lost step.
+  int64_t epoch = timens();
+  long int steps = 0;
+  Outcome outcome = PLAYING;
+
+  // how the steps kept up over the last second
+  struct step_stats stats = { 0, 0, 0, 0, 0, 0 };
+  long int windowSteps = 0;
+  int64_t windowLate = 0;
+  int64_t statsWindow = epoch;
+  int64_t nextMinimap = epoch;
+
+  while (outcome == PLAYING && !replay_over(play)) {
+
+    // Sleep until it's time to step, or we're told to stop.
+    int64_t nextStep = epoch + (steps + 1) * stepPeriod;
+    wait_readable(play->wake[0], -1, nextStep);
+    if (atomic_load(&play->quit)) break;
+
+    int64_t now = timens();
+    if (now - statsWindow >= NS_PER_SEC) {
+      stats.steps_per_sec = windowSteps * NS_PER_SEC / (now - statsWindow);
+      stats.late_us = windowLate / 1000;
+      windowSteps = windowLate = 0;
+      statsWindow = now;
+    }
 
-    case SOUTH:
-      newRow = MIN(head->loc->row+1, game->WALL_HT-2);
-      break;
+    // If the steps have fallen too far behind to catch up, say because
+    // the process was stopped, give up on the ones missed rather than
+    // racing through them. The schedule moves on by whole steps.
+    if (stepPeriod > 0 && now - nextStep > MAX_STEP_LAG) {
+      long int missed = (now - nextStep) / stepPeriod;
+      stats.lost += missed;
+      epoch += missed * stepPeriod;
+      nextStep += missed * stepPeriod;
+    }
+    if (now < nextStep) continue;
+
+    // Make every step that's due, which when a replay is played straight
+    // to the end is all of them. Food placement inside the step is timed
+    // on its own, so take it off the step's time.
+    while (outcome == PLAYING && now >= nextStep && !replay_over(play)) {
+      int64_t late = now - nextStep;
+      if (late > windowLate) windowLate = late;
+      if (metrics_enabled) metrics_record(PHASE_LATE, late);
+
+      int64_t start = metrics_begin();
+      uint64_t foodTime = hist_read(&metrics.phases[PHASE_FOOD].total);
+      struct turn turn;
+      int turned = play->replay == NULL && play->pilot == NULL &&
+                   pop_turn(&play->turns, &turn);
+      Direction input = turned ? turn.dir : state->dir;
+      if (play->replay != NULL) input = replay_input(play->replay, state->ticks, input);
+      else {
+        if (play->pilot != NULL) {
+          int64_t decided = metrics_begin();
+          input = autopilot_next(play->pilot, state);
+          metrics_end(PHASE_AUTOPILOT, decided);
+          start = metrics_begin();
+        }
+        if (play->record != NULL && input != state->dir && !opposites(input, state->dir)) {
+          record_turn(play->record, state->ticks, input);
+        }
+      }
+      struct point tail = snake_segment(snake, snake->length - 1);
+      outcome = game_step(state, input);
+      if (play->minimap.rows > 0) {
+        touch_minimap(&play->minimap, tail.row);
+        touch_minimap(&play->minimap, snake_head(snake).row);
+      }
+      if (metrics_enabled) {
+        foodTime = hist_read(&metrics.phases[PHASE_FOOD].total) - foodTime;
+        metrics_record(PHASE_STEP, metrics_begin() - start - foodTime);
+      }
+      steps++;
+      windowSteps++;
+      nextStep += stepPeriod;
+      if (turned) {
+        int64_t latency = timens() - turn.time;
+        if (metrics_enabled) metrics_record(PHASE_LATENCY, latency);
+        stats.key_latency_us = latency / 1000;
+      }
+    }
 
-    case WEST:
-      newCol = MAX(head->loc->col-1, 1);
-      break;
+    // Publish the board as it is now, and let the drawing thread know.
+    struct snapshot *snap = back_snapshot(&play->frames);
+    play->camera = follow_head(play->camera, snap, snake_head(snake), play->game);
+    fill_snapshot(snap, snake, state->food, play->camera);
+    snap->ticks = state->ticks;
+    snap->outcome = outcome;
+    snap->dir = state->dir;
+    snap->score = state->score;
+    if (snake->chunks != NULL) stats.chunks = snake->chunks->resident;
+    if (play->pilot != NULL) stats.overruns = play->pilot->overruns;
+    snap->stats = stats;
+
+    // Shrink the whole board down for the minimap, no more often than
+    // frames are drawn.
+    if (play->minimap.rows > 0 && now >= nextMinimap) {
+      struct point head = snake_head(snake);
+      int64_t start = metrics_begin();
+      summarise_board(&play->minimap, play->kernel, snake->bits, snake->words_per_row,
+                      play->game->WALL_HT, head.row, head.col, play->minimap_counts);
+      metrics_end(PHASE_MINIMAP, start);
+      nextMinimap = now + play->minimap_period;
+    }
+    snap->minimap = play->minimap;
+    publish_snapshot(&play->frames);
+    char c = 0;
+    if (write(play->ready[1], &c, 1) < 0) {
+      // The pipe is full, so the drawing thread has been told already.
+    }
 
-    case EAST:
-      newCol = MIN(head->loc->col+1, game->WALL_WD-2);
-      break;
   }
-  
-  // Return as a point.
-  struct point p = {newRow, newCol};
-  return p;
-
+  play->outcome = outcome;
+  return NULL;
 }
 
-/*  Construct a random point within the boundaries of the game. */
-struct point
-randomise_food (struct game_data *game, struct snake *head)
+/*  Play a game until the snake dies or wins or the player quits, or
+    resume the one saved when the player last quit, on the board it was
+    saved on. Does nothing if there's no saved game to resume. */
+void play_game (struct game_data *game, WINDOW *window, int resume)
 {
-  int row, col;
-  struct point p;
-  do {
-    int row = rand() % (game->WALL_HT-2) + 1;
-    int col = rand() % (game->WALL_WD-2) + 1;
-    p.row = row; p.col = col;
-  } while (touching(head, &p));
-  return p;
-}
 
+  // Start a game seeded from the clock. All of the game's memory comes
+  // from one arena, including the snapshots passed between the thread
+  // playing it and this one, which draws it. A resumed game uses the
+  // arrays in its save file where they are, so the file stays mapped
+  // until the game is over.
+  struct arena arena;
+  init_arena(&arena, ARENA_BLOCK_SIZE);
+  struct game_thread play;
+  play.game = game;
+  struct save_file save = { NULL, 0 };
+  if (resume && !load_game(&save, save_path, &play.state, game, &arena)) {
+    free_arena(&arena);
+    return;
+  }
 
-// ------------------------------------------------------------
-// Input functions.
-// ------------------------------------------------------------
+  // A board too big for the terminal is seen through a view of it, which
+  // leaves room for the HUD beside it.
+  game->view_ht = LINES;
+  game->view_wd = COLS - HUD_MARGIN - HUD_WIDTH;
+  if (game->view_ht < MIN_VIEW) game->view_ht = MIN_VIEW;
+  if (game->view_wd < MIN_VIEW) game->view_wd = MIN_VIEW;
+  int viewWd = game->view_wd < game->WALL_WD ? game->view_wd : game->WALL_WD;
+  hud_col = viewWd + HUD_MARGIN > HUD_MIN_COL ? viewWd + HUD_MARGIN : HUD_MIN_COL;
+
+  // A replay is played back from its own seed, at its speed times the
+  // speed it was recorded at. Otherwise the game can be recorded, unless
+  // it's carrying on from a save, which a replay can't start from.
+  uint64_t seed = replay != NULL ? replay->seed : time(NULL);
+  if (!resume) init_game(&play.state, game, &arena, seed);
+  init_turns(&play.turns, turn_depth, play.state.dir);
+  init_triple_buffer(&play.frames, &arena, game);
+  play.step_period = sim_hz > 0 ? NS_PER_SEC / sim_hz : update_delay(game) * NS_PER_MS;
+  struct replay record;
+  struct autopilot pilot;
+  play.replay = replay;
+  play.pilot = NULL;
+  play.record = NULL;
+  play.outcome = PLAYING;
+  if (replay != NULL) {
+    rewind_replay(replay);
+    play.step_period = replay_speed > 0 ? replay->step_ns / replay_speed : 0;
+  }
+  else {
+    if (autopilot) {
+      init_autopilot(&pilot, &arena, game, &pilot_config);
+      play.pilot = &pilot;
+    }
+    if (record_file != NULL && !resume) {
+      init_replay(&record, &arena, game, seed, play.step_period);
+      play.record = &record;
+    }
+  }
+  atomic_init(&play.quit, 0);
+
+  // A bounded board too big to see all at once gets a minimap of the
+  // whole of it.
+  struct snake *snake = play.state.snake;
+  play.minimap.rows = 0;
+  if (!game->unbounded && (game->WALL_HT > game->view_ht || game->WALL_WD > game->view_wd)) {
+    init_minimap(&play.minimap, game->WALL_HT, game->WALL_WD);
+    play.minimap_counts = arena_alloc(&arena, snake->words_per_row * sizeof (uint64_t));
+  }
+  play.kernel = best_popcount_kernel();
+  play.minimap_period = NS_PER_SEC / render_hz;
+
+  // Draw with ncurses, or by writing to the terminal ourselves, or not at
+  // all, or into a buffer. ncurses is the fallback if the buffer can't be
+  // made.
+  struct backend backend;
+  struct ansi_screen screen;
+  struct null_counts counts;
+  struct frame_buffer frame;
+  if (strcmp(backend_name, "ansi") == 0) {
+    init_ansi_backend(&backend, &screen, STDOUT_FILENO, LINES, COLS);
+  }
+  else if (strcmp(backend_name, "null") == 0) init_null_backend(&backend, &counts);
+  else if (strcmp(backend_name, "frame") != 0 ||
+           !init_frame_backend(&backend, &frame, frame_file, LINES, COLS)) {
+    init_curses_backend(&backend, window);
+  }
 
-/*  Process user input. Updates the direction of the snake depending
-    on what key the user presses. Will return a non-zero value if the
-    program should terminate. Otherwise it will return zero. */
-int process_input(Direction snake_dir, Direction *queued_dir)
-{
-    // get key code
-    int in = getch();
-
-    // check if user pushed escape
-    if (in == KEY_ESC) return 1;
-
-    // get direction the user pushed
-    Direction d2;
-    if (in == KEY_UP) d2 = NORTH;
-    else if (in == KEY_DOWN) d2 = SOUTH;
-    else if (in == KEY_LEFT) d2 = WEST;
-    else if (in == KEY_RIGHT) d2 = EAST;
-    else return 0;
-
-    // update queued direction, if snake can turn in that direction
-    if (!opposites(snake_dir, d2)) *queued_dir = d2;
-    return 0;
-}
+  // The snapshot last drawn. Nothing is drawn to start with, and the
+  // first frame draws everything.
+  struct snapshot drawn;
+  init_snapshot(&drawn, &arena, game);
+  struct damage damage = { .num_cells = 0, .full = 1 };
+  long int frameBytes = 0;
+
+  // The thread playing the game is woken through one pipe to stop, and
+  // wakes this one through another when there's a new snapshot. Neither
+  // end should ever block.
+  if (pipe(play.wake) != 0 || pipe(play.ready) != 0) {
+    backend.close(&backend);
+    free_arena(&arena);
+    close_save(&save);
+    return;
+  }
+  fcntl(play.ready[0], F_SETFL, O_NONBLOCK);
+  fcntl(play.ready[1], F_SETFL, O_NONBLOCK);
+
+  // Publish the board before the first step, so there's a frame to draw
+  // straight away.
+  struct snapshot *first = back_snapshot(&play.frames);
+  struct point corner = {0, 0};
+  play.camera = follow_head(corner, first, snake_head(play.state.snake), game);
+  fill_snapshot(first, play.state.snake, play.state.food, play.camera);
+  first->dir = play.state.dir;
+  publish_snapshot(&play.frames);
+
+  // Read keys straight from the terminal, and catch resizes ourselves
+  // since getch isn't called to report them.
+  struct input_decoder decoder;
+  init_decoder(&decoder);
+  struct sigaction onResize, oldResize;
+  memset(&onResize, 0, sizeof onResize);
+  onResize.sa_handler = on_window_change;
+  sigaction(SIGWINCH, &onResize, &oldResize);
+
+  pthread_create(&play.thread, NULL, simulate, &play);
+
+  // Frames are drawn at most once a frame period, and only when there's
+  // a new snapshot or the window needs repainting.
+  int64_t framePeriod = NS_PER_SEC / render_hz;
+  int64_t nextFrame = timens();
+  Outcome outcome = PLAYING;
+
+  // how many times the loop woke up in the last second
+  long int wakeups = 0, wakeupsPerSec = 0;
+  int64_t statsWindow = nextFrame;
+
+  // Whether the latest snapshot taken is still to be drawn, because the
+  // terminal was too far behind, and how many frames that has happened to.
+  int unsent = 0;
+  long int framesSkipped = 0;
+
+  // whether the replay being played back has been drawn to the end
+  int replayOver = 0;
+
+  while (outcome == PLAYING) {
+
+    // Sleep until there's a key to read, or a frame to draw and it's time
+    // to draw it.
+    int pending = damage.full || unsent || snapshot_ready(&play.frames);
+    if (pending) wait_readable(STDIN_FILENO, -1, nextFrame);
+    else wait_readable(STDIN_FILENO, play.ready[0], -1);
+    wakeups++;
+    char buf[64];
+    while (read(play.ready[0], buf, sizeof buf) > 0);
+
+    // Process input. Queue turns.
+    int resized = 0;
+    int64_t start = metrics_begin();
+    int quit = process_input(&decoder, &play.turns, &resized);
+    metrics_end(PHASE_INPUT, start);
+    if (quit) break;
+    if (resized) {
+      backend.resize(&backend, LINES, COLS);
+      damage.full = 1;
+    }
+    if (replay == NULL && play.pilot == NULL) draw_direction(play.turns.last, &backend);
 
-int opposites (Direction d1, Direction d2)
-{
-  if (d1 == NORTH && d2 == SOUTH) return 1;
-  if (d1 == SOUTH && d2 == NORTH) return 1;
-  if (d1 == WEST && d2 == EAST) return 1;
-  if (d1 == EAST && d2 == WEST) return 1;
-  return 0;
-}
+    int64_t now = timens();
+    if (now - statsWindow >= NS_PER_SEC) {
+      wakeupsPerSec = wakeups * NS_PER_SEC / (now - statsWindow);
+      wakeups = 0;
+      statsWindow = now;
+    }
 
+    // Draw the latest snapshot, if it's time to. Any published since the
+    // last frame have been dropped. The snake's last step into a wall or
+    // itself isn't drawn, unless it's being played back; the last frame of
+    // a won game is, straight away.
+    pending = damage.full || unsent || snapshot_ready(&play.frames);
+    if (!pending || now < nextFrame) continue;
+    struct snapshot *snap = latest_snapshot(&play.frames);
+    outcome = snap->outcome;
+    if (outcome == DIED && replay == NULL) break;
+    nextFrame = now + framePeriod;
+
+    // If the terminal hasn't caught up with the last frame, skip this one
+    // rather than pile more on. The next frame drawn only sends the cells
+    // which differ from the last one drawn, however many were skipped.
+    if (output_backlogged(STDOUT_FILENO, max_backlog)) {
+      unsent = 1;
+      framesSkipped++;
+      if (metrics_enabled) metrics.frames_skipped++;
+      continue;
+    }
+    unsent = 0;
+    if (metrics_enabled) metrics.frames++;
+
+    start = metrics_begin();
+    mark_changes(&damage, &drawn, snap);
+    draw_damage(&damage, game, snap, &backend);
+    int steered = replay == NULL && play.pilot == NULL;
+    draw_direction(steered ? play.turns.last : snap->dir, &backend);
+    draw_stat(3, "wakeups/s", wakeupsPerSec, &backend);
+    draw_stat(4, "bytes/frame", frameBytes, &backend);
+    draw_stat(5, "key->tick us", snap->stats.key_latency_us, &backend);
+    draw_stat(6, "turns dropped", play.turns.dropped, &backend);
+    draw_stat(7, "queue overflows", play.turns.overflows, &backend);
+    draw_stat(8, "steps/s", snap->stats.steps_per_sec, &backend);
+    draw_stat(9, "step late us", snap->stats.late_us, &backend);
+    draw_stat(10, "steps lost", snap->stats.lost, &backend);
+    draw_stat(11, "frames skipped", framesSkipped, &backend);
+    if (game->unbounded) draw_stat(12, "chunks", snap->stats.chunks, &backend);
+    if (play.pilot != NULL) draw_stat(13, "pilot overruns", snap->stats.overruns, &backend);
+    draw_minimap(&snap->minimap, &backend);
+    if (metrics_enabled) {
+      int metricsRow = play.minimap.rows > 0 ? MINIMAP_ROW + play.minimap.rows + 1 : METRICS_ROW;
+      draw_metrics(metricsRow, &backend);
+    }
+    metrics_end(PHASE_DRAW, start);
+
+    long int before = backend.bytes;
+    start = metrics_begin();
+    backend.present(&backend);
+    metrics_end(PHASE_REFRESH, start);
+    frameBytes = backend.bytes - before;
+    if (replay != NULL && (outcome != PLAYING || snap->ticks >= replay->ticks)) {
+      replayOver = 1;
+      break;
+    }
 
-void play_game (struct game_data *game, WINDOW *window)
-{
+  }
 
-  // Seed rand and set non-blocking input.
-  srand(time(NULL));
-  timeout(0);
-
-  // Initialise snake.
-  struct snake *snake = init_snake(NULL, game->WALL_HT/2, game->WALL_WD/2);
-  snake = init_snake(snake, game->WALL_HT/2 + 1, game->WALL_WD/2);
-  snake = init_snake(snake, game->WALL_HT/2 + 1, game->WALL_WD/2);
-  
-  // remember direction of snake, last time step.
-  long int lastUpdate = timems();
-  Direction snake_dir = NORTH;
-  Direction queued_dir = NORTH;
-
-  // position of food
-  struct point food = randomise_food(game, snake);
-  int ate_food = 0;
-
-  while (1) {
-
-    // Process input. Update queued directino.
-    if (process_input(snake_dir, &queued_dir)) break;
-    draw_direction(queued_dir, window);
-
-    // Check if you should update.
-    long int currTime = timems();
-    if (currTime - lastUpdate < update_delay(game)) continue;
-    lastUpdate = currTime;
-
-    // Get direction. Move snake and grow in length.
-    snake_dir = queued_dir;
-    struct point newpos = new_pos(game, snake, snake_dir);
-    if (ate_food) {
-      grow_snake(game, &snake, newpos);
-      ate_food = 0;        
-    }
-    else move_snake(game, snake, newpos);
-    
-    // Snake touching itself? Game over, man!
-    if (touching(snake->next, snake->loc)) break;
-
-    // If Snake has eaten food, randomly generate new food.
-    if (touching(snake, &food)) {
-      food = randomise_food(game, snake);
-      ate_food = 1;
-    }
-
-    // Clear window and redraw.
-    wclear(window);
-    draw_snake(snake, window);
-    draw_food(food, window);
-    draw_wall(game, window);
-    wrefresh(window);
+  // Stop the game, if it's still going.
+  atomic_store(&play.quit, 1);
+  char c = 0;
+  if (write(play.wake[1], &c, 1) < 0) {
+    // Can't happen: nothing else is ever written to the pipe.
+  }
+  pthread_join(play.thread, NULL);
+  close(play.wake[0]);
+  close(play.wake[1]);
+  close(play.ready[0]);
+  close(play.ready[1]);
+
+  // Save the game as it was played, however it ended.
+  if (play.record != NULL) {
+    end_replay(&record, &play.state, play.outcome);
+    if (!save_replay(&record, record_file)) record_failed = 1;
+  }
 
+  // Keep a game the player quit, to be resumed later. A resumed game
+  // which has ended can't be resumed again.
+  if (replay == NULL && play.outcome == PLAYING) {
+    if (!save_game(&play.state, save_path)) save_failed = 1;
+  }
+  else if (resume) unlink(save_path);
+
+  // Leave the full board up until the player presses a key.
+  if (outcome == WON || replayOver) {
+    backend.print(&backend, 12, hud_col, replayOver ? "Replay over" : "You win!");
+    backend.present(&backend);
+    wait_readable(STDIN_FILENO, -1, -1);
+    struct input_event events[MAX_INPUT_EVENTS];
+    read_input(&decoder, STDIN_FILENO, events, MAX_INPUT_EVENTS);
   }
 
   // Free memory.
-  del_snake(snake, 1);
+  backend.close(&backend);
+  free_arena(&arena);
+  close_save(&save);
 
   // Clean output.
   wclear(window);
 
-  // Re-enable blocking input.
-  timeout(-1);
+  // Hand resizes back to ncurses.
+  sigaction(SIGWINCH, &oldResize, NULL);
 
 }
 
@@ -430,7 +698,102 @@ void play_game (struct game_data *game, WINDOW *window)
 int
 main (int argc, char *argv[])
 {
-  
+
+  // Simulating games, or checking replays? Then there's no terminal to
+  // set up. Timing the game? Then remember where to write the timings.
+  // The number of turns that can be queued up, the step and frame rates,
+  // how far behind the terminal can get, what draws the game and into
+  // which file, the size of the board or whether it has one, and where to
+  // record games to can be set too, and the snake can be left to play
+  // itself. Or a recorded game can be played back, at some speed.
+  char *metrics_file = NULL;
+  char *replay_file = NULL;
+  int i;
+  for (i=1; i<argc; i++) {
+    if (strcmp(argv[i], "--headless") == 0) return headless_main(argc, argv);
+    if (strcmp(argv[i], "--verify") == 0) return headless_main(argc, argv);
+    if (strcmp(argv[i], "--metrics") == 0 && i+1 < argc) {
+      metrics_enabled = 1;
+      metrics_file = argv[++i];
+    }
+    if (strcmp(argv[i], "--turn-depth") == 0 && i+1 < argc) {
+      turn_depth = atoi(argv[++i]);
+    }
+    if (strcmp(argv[i], "--sim-hz") == 0 && i+1 < argc) {
+      sim_hz = atoi(argv[++i]);
+      if (sim_hz < 0) sim_hz = 0;
+      if (sim_hz > MAX_SIM_HZ) sim_hz = MAX_SIM_HZ;
+    }
+    if (strcmp(argv[i], "--backend") == 0 && i+1 < argc) {
+      backend_name = argv[++i];
+    }
+    if (strcmp(argv[i], "--width") == 0 && i+1 < argc) {
+      board_wd = atoi(argv[++i]);
+      if (board_wd < MIN_BOARD) board_wd = MIN_BOARD;
+      if (board_wd > MAX_BOARD) board_wd = MAX_BOARD;
+    }
+    if (strcmp(argv[i], "--height") == 0 && i+1 < argc) {
+      board_ht = atoi(argv[++i]);
+      if (board_ht < MIN_BOARD) board_ht = MIN_BOARD;
+      if (board_ht > MAX_BOARD) board_ht = MAX_BOARD;
+    }
+    if (strcmp(argv[i], "--unbounded") == 0) unbounded = 1;
+    if (strcmp(argv[i], "--frame") == 0 && i+1 < argc) {
+      frame_file = argv[++i];
+    }
+    if (strcmp(argv[i], "--record") == 0 && i+1 < argc) {
+      record_file = argv[++i];
+    }
+    if (strcmp(argv[i], "--save") == 0 && i+1 < argc) {
+      save_path = argv[++i];
+    }
+    if (strcmp(argv[i], "--autopilot") == 0) autopilot = 1;
+    if (strcmp(argv[i], "--autopilot-us") == 0 && i+1 < argc) {
+      pilot_config.budget_us = atoi(argv[++i]);
+      if (pilot_config.budget_us < 1) pilot_config.budget_us = 1;
+    }
+    if (strcmp(argv[i], "--autopilot-cycle") == 0) autopilot = pilot_config.cycle = 1;
+    if (strcmp(argv[i], "--replay") == 0 && i+1 < argc) {
+      replay_file = argv[++i];
+    }
+    if (strcmp(argv[i], "--speed") == 0 && i+1 < argc) {
+      i++;
+      replay_speed = strcmp(argv[i], "instant") == 0 ? 0 : atoi(argv[i]);
+      if (replay_speed < 1 && strcmp(argv[i], "instant") != 0) replay_speed = 1;
+    }
+    if (strcmp(argv[i], "--max-backlog") == 0 && i+1 < argc) {
+      max_backlog = atoi(argv[++i]);
+      if (max_backlog < 0) {
+        fprintf(stderr, "%s: --max-backlog must be 0 or more\n", argv[0]);
+        return 1;
+      }
+    }
+    if (strcmp(argv[i], "--render-hz") == 0 && i+1 < argc) {
+      render_hz = atoi(argv[++i]);
+      if (render_hz < 1) render_hz = 1;
+      if (render_hz > MAX_RENDER_HZ) render_hz = MAX_RENDER_HZ;
+    }
+  }
+
+  // Quit games are saved in the home directory, unless told otherwise.
+  char defaultSave[4096];
+  if (save_path == NULL) {
+    char *home = getenv("HOME");
+    snprintf(defaultSave, sizeof defaultSave, "%s/%s", home != NULL ? home : ".", SAVE_FILE_NAME);
+    save_path = defaultSave;
+  }
+
+  // Open the replay before touching the terminal, so that if it can't be
+  // played there's somewhere to say so.
+  struct replay loaded;
+  if (replay_file != NULL) {
+    if (!open_replay(&loaded, replay_file)) {
+      perror(replay_file);
+      return 1;
+    }
+    replay = &loaded;
+  }
+
   // Establish ncurses.
   initscr();
 
@@ -441,8 +804,11 @@ main (int argc, char *argv[])
   // Enable function keys to be registered by ncurses.
   keypad(stdscr, TRUE);
 
-  // Enable blocking input.
+  // Enable blocking input, and don't keep the menu waiting long after
+  // escape is pressed.
+  cbreak();
   timeout(-1);
+  set_escdelay(MENU_ESCDELAY);
 
   // Enable colours.
   if (has_colors() == FALSE) {
@@ -451,73 +817,100 @@ main (int argc, char *argv[])
   }
   start_color();
   menu_init_colours();
-  init_pair(1, COLOR_WHITE, COLOR_WHITE); // snake colour
-  init_pair(2, COLOR_CYAN, COLOR_CYAN); // wall colour
-  init_pair(3, COLOR_RED, COLOR_RED); // food colour
+  curses_init_colours();
 
-  // Create windows for menu and game.
+  // Create windows for menu and game. The menu is always drawn with
+  // ncurses.
   WINDOW *window_menu = newwin(30, 30, 0, 0);
   WINDOW *window_game = newwin(0, 0, 0, 0);
-
-  // Allocate memory for menu items.
-  ITEM *item1 = malloc(sizeof (ITEM));
-  ITEM *item2 = malloc(sizeof (ITEM));
-  ITEM *item3 = malloc(sizeof (ITEM));
-
-  // Create menu items.
-  make_item_text(item1, "Play");
-  make_item_slider(item2, "Difficulty", 10);
-  make_item_exit(item3, "Exit");
-
-  // Allocate memory for menu; create menu.
-  ITEM *items[] = { item1, item2, item3 };
-  MENU *menu = malloc(sizeof (MENU));
+  struct backend menu_backend;
+  init_curses_backend(&menu_backend, window_menu);
+
+  // Create menu items. The menu and its items live for as long as main,
+  // so they can go on the stack.
+  ITEM item1, item2, item3, item4;
+  make_item_text(&item1, "Play");
+  make_item_text(&item4, "Resume");
+  make_item_slider(&item2, "Difficulty", 10);
+  make_item_exit(&item3, "Exit");
+
+  // Create menu.
+  ITEM *items[] = { &item1, &item4, &item2, &item3 };
+  MENU menu_data;
+  MENU *menu = &menu_data;
   int num_items = sizeof(items) / sizeof(items[0]);
-  make_menu(menu, window_menu, items, num_items);
+  make_menu(menu, &menu_backend, items, num_items);
 
   // Create and set game data.
-  struct game_data *game = malloc(sizeof (struct game_data));
-  game->WALL_WD = 20;
-  game->WALL_HT = 20;
+  struct game_data game_data;
+  struct game_data *game = &game_data;
+  game->WALL_WD = board_wd;
+  game->WALL_HT = board_ht;
+  game->unbounded = unbounded;
   game->difficulty = 0;
   int rows, cols;
   getmaxyx(stdscr, rows, cols);
   game->rows = rows;
   game->cols = cols;
 
-  // Display menu, get options.
-  while (1) {
-    EVENT *event;
+  // Play the replay back, if there is one, and go.
+  if (replay != NULL) {
+    replay_board(replay, game);
+    play_game(game, window_game, 0);
+  }
+
+  // Otherwise display menu, get options.
+  while (replay == NULL) {
+    EVENT event;
     int done = 0;
     while (!done) {
-      event = malloc(sizeof (EVENT));
       menu_refresh(menu);
-      menu_run(menu, event);
-      EVENT_TYPE type = event_type(event);
+      menu_run(menu, &event);
+      EVENT_TYPE type = event_type(&event);
       if (type == EXIT) done = 1;
       else if (type == TEXT_RETURN) done = 2;
-      free(event);
     }
 
-    // User wants to play a game.
+    // User wants to play a game, or carry on with the saved one. That's
+    // on the board it was saved on, which the next new game isn't.
     if (done == 2) {
-      game->difficulty = slider_value(item2);
+      game->difficulty = slider_value(&item2);
       wclear(window_menu);
-      play_game(game, window_game);
+      if (event_item(&event) == &item4) {
+        struct game_data saved = *game;
+        play_game(&saved, window_game, 1);
+      }
+      else play_game(game, window_game, 0);
     }
 
-    // User exited. Tidy up and return.
-    if (done == 1) {
-      wclear(window_menu);
-      wclear(window_game);
-      delwin(window_menu);
-      delwin(window_game);
-      free(game);   
-      free_menu(menu);
-      endwin();
-      return 0;
+    // User exited.
+    if (done == 1) break;
+  }
+
+  // Tidy up and return.
+  wclear(window_menu);
+  wclear(window_game);
+  delwin(window_menu);
+  delwin(window_game);
+  endwin();
+  if (replay != NULL) close_replay(replay);
+  if (record_failed) {
+    fprintf(stderr, "%s: could not record the game\n", record_file);
+    return 1;
+  }
+  if (save_failed) {
+    fprintf(stderr, "%s: could not save the game\n", save_path);
+    return 1;
+  }
+  if (metrics_file != NULL) {
+    FILE *out = fopen(metrics_file, "w");
+    if (out == NULL) {
+      perror(metrics_file);
+      return 1;
     }
+    metrics_dump(out);
+    fclose(out);
   }
+  return 0;
 
 }
-
@@ -0,0 +1,153 @@
+// ------------------------------------------------------------
+// Imports.
+// ------------------------------------------------------------
+
+#include <string.h>
+
+#include "snapshot.h"
+
+// ------------------------------------------------------------
+// Macros.
+// ------------------------------------------------------------
+
+// set in triple_buffer.latest when the reader hasn't taken it yet
+#define SNAPSHOT_FRESH 4
+#define SNAPSHOT_INDEX 3
+
+
+
+// ------------------------------------------------------------
+// Snapshot functions.
+// ------------------------------------------------------------
+
+/*  Set up an empty snapshot of a board, with its cells in the arena. It
+    holds as much of the board as the game's view does, which on an
+    unbounded board is all of the view. */
+void
+init_snapshot (struct snapshot *snap, struct arena *arena, struct game_data *game)
+{
+  memset(snap, 0, sizeof *snap);
+  snap->outcome = PLAYING;
+  snap->rows = game->WALL_HT;
+  snap->cols = game->WALL_WD;
+  int fits = !game->unbounded;
+  if (game->view_ht > 0 && (game->view_ht < snap->rows || !fits)) snap->rows = game->view_ht;
+  if (game->view_wd > 0 && (game->view_wd < snap->cols || !fits)) snap->cols = game->view_wd;
+  snap->cells = arena_calloc(arena, snap->rows * snap->cols);
+}
+
+/*  Copy where the snake and food are into a snapshot, taking the part of
+    the board in view from origin. The rest of it is up to whoever is
+    taking the snapshot. */
+void
+fill_snapshot (struct snapshot *snap, struct snake *snake, struct point food,
+               struct point origin)
+{
+  read_cells(snake, origin, snap->rows, snap->cols, snap->cells);
+  snap->origin = origin;
+  snap->food = food;
+  snap->length = snake->length;
+}
+
+/*  Move one axis of a view of size cells, starting at at, so that pos is
+    well inside it. board is how many cells the axis has, or zero if it
+    goes on forever. */
+static int
+follow (int at, int pos, int size, int board)
+{
+  int margin = size / 4;
+  if (pos < at + margin || pos >= at + size - margin) at = pos - size / 2;
+  if (board == 0) return at;
+  if (at > board - size) at = board - size;
+  if (at < 0) at = 0;
+  return at;
+}
+
+/*  Get where a snapshot's view of the board should start for the snake's
+    head, given where it started last time. The view stays put while the
+    head is more than a quarter of the view from its edges, and jumps to
+    centre on the head when it isn't, so the board is redrawn every so
+    often rather than every step. It never goes past the walls, if there
+    are any. */
+struct point
+follow_head (struct point origin, struct snapshot *snap,
+             struct point head, struct game_data *game)
+{
+  int unbounded = game->unbounded;
+  origin.row = follow(origin.row, head.row, snap->rows, unbounded ? 0 : game->WALL_HT);
+  origin.col = follow(origin.col, head.col, snap->cols, unbounded ? 0 : game->WALL_WD);
+  return origin;
+}
+
+/*  Check whether a cell of the board is in a snapshot's view. */
+int
+in_view (struct snapshot *snap, struct point p)
+{
+  return p.row >= snap->origin.row && p.row < snap->origin.row + snap->rows &&
+         p.col >= snap->origin.col && p.col < snap->origin.col + snap->cols;
+}
+
+/*  Copy one snapshot of a board over another of the same board. */
+void
+copy_snapshot (struct snapshot *to, struct snapshot *from)
+{
+  unsigned char *cells = to->cells;
+  *to = *from;
+  to->cells = cells;
+  memcpy(to->cells, from->cells, from->rows * from->cols);
+}
+
+
+
+// ------------------------------------------------------------
+// Triple buffer functions.
+// ------------------------------------------------------------
+
+void
+init_triple_buffer (struct triple_buffer *buffer, struct arena *arena,
+                    struct game_data *game)
+{
+  int i;
+  for (i=0; i<3; i++) init_snapshot(&buffer->snaps[i], arena, game);
+  buffer->back = 0;
+  atomic_init(&buffer->latest, 1);
+  buffer->front = 2;
+}
+
+/*  Get the snapshot the writer should fill in next. */
+struct snapshot *
+back_snapshot (struct triple_buffer *buffer)
+{
+  return &buffer->snaps[buffer->back];
+}
+
+/*  Make the snapshot the writer has filled in the latest one, and take
+    whichever it replaces to fill in next. */
+void
+publish_snapshot (struct triple_buffer *buffer)
+{
+  int old = atomic_exchange_explicit(&buffer->latest, buffer->back | SNAPSHOT_FRESH,
+                                     memory_order_acq_rel);
+  buffer->back = old & SNAPSHOT_INDEX;
+}
+
+/*  Check whether a snapshot has been published since the reader last
+    took one. */
+int
+snapshot_ready (struct triple_buffer *buffer)
+{
+  return atomic_load_explicit(&buffer->latest, memory_order_acquire) & SNAPSHOT_FRESH;
+}
+
+/*  Get the latest snapshot for the reader. If nothing has been published
+    since last time, this is the same one as then. */
+struct snapshot *
+latest_snapshot (struct triple_buffer *buffer)
+{
+  if (snapshot_ready(buffer)) {
+    int old = atomic_exchange_explicit(&buffer->latest, buffer->front,
+                                       memory_order_acq_rel);
+    buffer->front = old & SNAPSHOT_INDEX;
+  }
+  return &buffer->snaps[buffer->front];
+}
@@ -0,0 +1,81 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdatomic.h>
+
+#include "arena.h"
+#include "game.h"
+#include "minimap.h"
+
+// ------------------------------------------------------------
+// Typedefs, enums.
+// ------------------------------------------------------------
+
+// How the thread playing a game is keeping up with its schedule, over the
+// last second: steps made, the latest a step started, and how long the
+// last turn took to reach the snake from its key. Steps given up on after
+// falling too far behind are counted for the whole game. On an unbounded
+// board, chunks is how many chunks of it are resident. If the snake is
+// playing itself, overruns is how many of its moves have taken longer to
+// decide than their budget.
+struct step_stats {
+  long int steps_per_sec;
+  long int late_us;
+  long int lost;
+  long int key_latency_us;
+  long int chunks;
+  long int overruns;
+};
+
+// A game as it was after some step, made by the thread playing it for the
+// thread drawing it. Nothing in it changes once it has been published.
+// Only the part of the board in view is kept: cells has rows rows of cols
+// cells, non-zero where the snake is, and origin is the cell of the board
+// at its top left. Everything else is in board coordinates. minimap is the
+// whole board shrunk down, if it's too big to see all at once.
+struct snapshot {
+  long int ticks;
+  Outcome outcome;
+  Direction dir;
+  struct point food;
+  int score;
+  int length;
+  int rows;
+  int cols;
+  struct point origin;
+  unsigned char *cells;
+  struct step_stats stats;
+  struct minimap minimap;
+};
+
+// Hands snapshots from one thread to another without either waiting. The
+// writer fills snaps[back] and swaps it with latest; the reader swaps
+// latest with snaps[front] when there is something new. The two never
+// touch the same snapshot, and a snapshot the reader never got round to
+// is overwritten rather than queued.
+struct triple_buffer {
+  struct snapshot snaps[3];
+  _Atomic int latest;
+  int back;
+  int front;
+};
+
+// ------------------------------------------------------------
+// Function declarations.
+// ------------------------------------------------------------
+
+void init_snapshot (struct snapshot *snap, struct arena *arena, struct game_data *game);
+void fill_snapshot (struct snapshot *snap, struct snake *snake, struct point food,
+                    struct point origin);
+struct point follow_head (struct point origin, struct snapshot *snap,
+                          struct point head, struct game_data *game);
+int in_view (struct snapshot *snap, struct point p);
+void copy_snapshot (struct snapshot *to, struct snapshot *from);
+void init_triple_buffer (struct triple_buffer *buffer, struct arena *arena,
+                         struct game_data *game);
+struct snapshot *back_snapshot (struct triple_buffer *buffer);
+void publish_snapshot (struct triple_buffer *buffer);
+int snapshot_ready (struct triple_buffer *buffer);
+struct snapshot *latest_snapshot (struct triple_buffer *buffer);
+
+#endif